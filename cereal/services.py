@@ -26,6 +26,7 @@ _services: dict[str, tuple] = {
   "controlsState": (True, 100., 10),
   "pandaStates": (True, 10., 1),
   "peripheralState": (True, 2., 1),
+  "pandaCanStats": (True, 1., 1),
   "radarState": (True, 20., 5),
   "roadEncodeIdx": (False, 20., 1),
   "liveTracks": (True, 20.),
@@ -73,6 +74,7 @@ _services: dict[str, tuple] = {
   "mapRenderState": (True, 2., 1.),
   "uiPlan": (True, 20., 40.),
   "qRoadEncodeIdx": (False, 20.),
+  "encoderStats": (True, 1., 1),
   "userFlag": (True, 0., 1),
   "microphone": (True, 10., 10),
 
@@ -86,6 +88,7 @@ _services: dict[str, tuple] = {
   "livestreamWideRoadEncodeIdx": (False, 20.),
   "livestreamRoadEncodeIdx": (False, 20.),
   "livestreamDriverEncodeIdx": (False, 20.),
+  "livestreamEncoderStats": (False, 1.),
   "livestreamWideRoadEncodeData": (False, 20.),
   "livestreamRoadEncodeData": (False, 20.),
   "livestreamDriverEncodeData": (False, 20.),
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// counts of samples in buckets with the given upper edges, the last bucket is unbounded
+class TelemetryHistogram {
+public:
+  TelemetryHistogram(std::vector<float> edges) : edges(edges), counts(edges.size() + 1) {}
+
+  void add(float v, uint32_t n = 1) {
+    counts[std::lower_bound(edges.begin(), edges.end(), v) - edges.begin()] += n;
+    total += n;
+    max_value = std::max(max_value, v);
+  }
+
+  // upper edge of the bucket containing the percentile
+  float percentile(double p) const {
+    uint64_t sum = 0;
+    for (int i = 0; i < edges.size(); ++i) {
+      sum += counts[i];
+      if (sum > 0 && sum >= p * total) return std::min(edges[i], max_value);
+    }
+    return max_value;
+  }
+
+  // into a cereal Histogram
+  template <typename Builder>
+  void to_capnp(Builder h) const {
+    h.setUpperEdges(kj::ArrayPtr<const float>(edges.data(), edges.size()));
+    h.setCounts(kj::ArrayPtr<const uint32_t>(counts.data(), counts.size()));
+  }
+
+  void clear() {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+    max_value = 0;
+  }
+
+  float max_value = 0;
+
+private:
+  const std::vector<float> edges;
+  std::vector<uint32_t> counts;
+  uint64_t total = 0;
+};
@@ -0,0 +1,194 @@
+#include "common/nv12_scale.h"
+
+#include <cassert>
+#include <cstring>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NV12_SCALE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define NV12_SCALE_SSE2
+#endif
+
+// source index of destination index i, in 16.16 fixed point like libyuv's point sampling
+static std::vector<int> sample_positions(int src_size, int dst_size) {
+  const int64_t step = ((int64_t)src_size << 16) / dst_size;
+  std::vector<int> pos(dst_size);
+  for (int64_t i = 0, x = step >> 1; i < dst_size; ++i, x += step) {
+    pos[i] = x >> 16;
+  }
+  return pos;
+}
+
+// with the width unchanged libyuv only scales vertically, from the first row instead of half a step in
+static std::vector<int> sample_rows_vertical(int src_size, int dst_size) {
+  const int64_t step = ((int64_t)src_size << 16) / dst_size;
+  std::vector<int> pos(dst_size);
+  for (int64_t i = 0, y = 0; i < dst_size; ++i, y += step) {
+    pos[i] = y >> 16;
+  }
+  return pos;
+}
+
+// libyuv scales by exactly 3/8 with its own kernel, which takes 0, 3 and 6 of every 8
+static std::vector<int> sample_positions_38(int dst_size) {
+  std::vector<int> pos(dst_size);
+  for (int i = 0; i < dst_size; ++i) {
+    pos[i] = (i / 3) * 8 + (i % 3) * 3;
+  }
+  return pos;
+}
+
+Nv12Scaler::Plane::Plane(int src_width, int src_height, int dst_width, int dst_height) {
+  if (8 * dst_width == 3 * src_width && 8 * dst_height == 3 * src_height) {
+    cols = sample_positions_38(dst_width);
+    rows = sample_positions_38(dst_height);
+  } else if (dst_width == src_width) {
+    cols = sample_positions(src_width, dst_width);
+    rows = sample_rows_vertical(src_height, dst_height);
+  } else {
+    cols = sample_positions(src_width, dst_width);
+    rows = sample_positions(src_height, dst_height);
+  }
+  for (int k : {1, 2, 4}) {
+    if (src_width == k * dst_width) step = k;
+  }
+}
+
+Nv12Scaler::Nv12Scaler(int src_width, int src_height, int dst_width, int dst_height)
+    : dst_width(dst_width), dst_height(dst_height),
+      y(src_width, src_height, dst_width, dst_height),
+      uv(src_width / 2, src_height / 2, dst_width / 2, dst_height / 2) {
+  assert(dst_width <= src_width && dst_height <= src_height);
+  assert(src_width % 2 == 0 && src_height % 2 == 0 && dst_width % 2 == 0 && dst_height % 2 == 0);
+}
+
+// every step-th byte from step/2 on, returns the number of bytes written
+static int scale_row_y(const uint8_t *src, uint8_t *dst, int width, int step) {
+  int i = 0;
+  if (step == 1) {
+    memcpy(dst, src, width);
+    return width;
+  }
+#if defined(NV12_SCALE_NEON)
+  if (step == 2) {
+    for (; i + 16 <= width; i += 16) vst1q_u8(dst + i, vld2q_u8(src + i * 2).val[1]);
+  } else if (step == 4) {
+    for (; i + 16 <= width; i += 16) vst1q_u8(dst + i, vld4q_u8(src + i * 4).val[2]);
+  }
+#elif defined(NV12_SCALE_SSE2)
+  if (step == 2) {
+    for (; i + 16 <= width; i += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(src + i * 2));
+      __m128i b = _mm_loadu_si128((const __m128i *)(src + i * 2 + 16));
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+  } else if (step == 4) {
+    const __m128i mask = _mm_set1_epi32(0xff);
+    for (; i + 16 <= width; i += 16) {
+      __m128i v[4];
+      for (int j = 0; j < 4; ++j) {
+        v[j] = _mm_and_si128(_mm_srli_epi32(_mm_loadu_si128((const __m128i *)(src + i * 4 + j * 16)), 16), mask);
+      }
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3])));
+    }
+  }
+#endif
+  return i;
+}
+
+#if defined(NV12_SCALE_SSE2)
+// splits 32-bit lanes holding a uv pair in their low 16 bits
+static inline void split_uv_pairs(const __m128i p[4], uint8_t *u, uint8_t *v) {
+  const __m128i mask = _mm_set1_epi32(0xff);
+  __m128i lo[4], hi[4];
+  for (int j = 0; j < 4; ++j) {
+    lo[j] = _mm_and_si128(p[j], mask);
+    hi[j] = _mm_and_si128(_mm_srli_epi32(p[j], 8), mask);
+  }
+  _mm_storeu_si128((__m128i *)u, _mm_packus_epi16(_mm_packs_epi32(lo[0], lo[1]), _mm_packs_epi32(lo[2], lo[3])));
+  _mm_storeu_si128((__m128i *)v, _mm_packus_epi16(_mm_packs_epi32(hi[0], hi[1]), _mm_packs_epi32(hi[2], hi[3])));
+}
+#endif
+
+// every step-th uv pair from step/2 on, split into u and v, returns the number of pairs written
+static int scale_row_uv(const uint8_t *src, uint8_t *dst_u, uint8_t *dst_v, int width, int step) {
+  int i = 0;
+#if defined(NV12_SCALE_NEON)
+  if (step == 1) {
+    for (; i + 16 <= width; i += 16) {
+      uint8x16x2_t p = vld2q_u8(src + i * 2);
+      vst1q_u8(dst_u + i, p.val[0]);
+      vst1q_u8(dst_v + i, p.val[1]);
+    }
+  } else if (step == 2) {
+    for (; i + 16 <= width; i += 16) {
+      uint8x16x4_t p = vld4q_u8(src + i * 4);
+      vst1q_u8(dst_u + i, p.val[2]);
+      vst1q_u8(dst_v + i, p.val[3]);
+    }
+  } else if (step == 4) {
+    for (; i + 8 <= width; i += 8) {
+      uint16x8_t p = vld4q_u16((const uint16_t *)(src + i * 8)).val[2];
+      vst1_u8(dst_u + i, vmovn_u16(p));
+      vst1_u8(dst_v + i, vshrn_n_u16(p, 8));
+    }
+  }
+#elif defined(NV12_SCALE_SSE2)
+  if (step == 1) {
+    const __m128i mask = _mm_set1_epi16(0xff);
+    for (; i + 16 <= width; i += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(src + i * 2));
+      __m128i b = _mm_loadu_si128((const __m128i *)(src + i * 2 + 16));
+      _mm_storeu_si128((__m128i *)(dst_u + i), _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+      _mm_storeu_si128((__m128i *)(dst_v + i), _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+  } else if (step == 2) {
+    for (; i + 16 <= width; i += 16) {
+      __m128i p[4];
+      for (int j = 0; j < 4; ++j) {
+        p[j] = _mm_srli_epi32(_mm_loadu_si128((const __m128i *)(src + i * 4 + j * 16)), 16);
+      }
+      split_uv_pairs(p, dst_u + i, dst_v + i);
+    }
+  } else if (step == 4) {
+    for (; i + 16 <= width; i += 16) {
+      __m128i p[4];
+      for (int j = 0; j < 4; ++j) {
+        // the third pair of both 64-bit halves of two loads
+        __m128i a = _mm_srli_epi64(_mm_loadu_si128((const __m128i *)(src + i * 8 + j * 32)), 32);
+        __m128i b = _mm_srli_epi64(_mm_loadu_si128((const __m128i *)(src + i * 8 + j * 32 + 16)), 32);
+        a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+        b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+        p[j] = _mm_and_si128(_mm_unpacklo_epi64(a, b), _mm_set1_epi32(0xffff));
+      }
+      split_uv_pairs(p, dst_u + i, dst_v + i);
+    }
+  }
+#endif
+  return i;
+}
+
+void Nv12Scaler::scale(const uint8_t *src_y, int src_stride_y, const uint8_t *src_uv, int src_stride_uv,
+                       uint8_t *dst_y, int dst_stride_y, uint8_t *dst_u, int dst_stride_u, uint8_t *dst_v, int dst_stride_v) const {
+  const int width = y.cols.size();
+  for (int j = 0; j < y.rows.size(); ++j) {
+    const uint8_t *src = src_y + (size_t)y.rows[j] * src_stride_y;
+    uint8_t *dst = dst_y + (size_t)j * dst_stride_y;
+    for (int i = scale_row_y(src, dst, width, y.step); i < width; ++i) {
+      dst[i] = src[y.cols[i]];
+    }
+  }
+
+  const int uv_width = uv.cols.size();
+  for (int j = 0; j < uv.rows.size(); ++j) {
+    const uint8_t *src = src_uv + (size_t)uv.rows[j] * src_stride_uv;
+    uint8_t *u = dst_u + (size_t)j * dst_stride_u;
+    uint8_t *v = dst_v + (size_t)j * dst_stride_v;
+    for (int i = scale_row_uv(src, u, v, uv_width, uv.step); i < uv_width; ++i) {
+      u[i] = src[uv.cols[i] * 2];
+      v[i] = src[uv.cols[i] * 2 + 1];
+    }
+  }
+}
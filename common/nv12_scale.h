@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Point sampled downscale of an NV12 image into I420 planes, in one pass that only reads the sampled
+// rows and columns of the source, without converting the full resolution frame first. It samples like
+// libyuv's NV12ToI420 followed by I420Scale with kFilterNone, and the tests check the output is the same
+// for each way libyuv samples: its kernels for the exact 1/2, 1/4, 3/4 and 3/8 ratios, the vertical only
+// scale when the width is unchanged and the general point sampling of other ratios.
+class Nv12Scaler {
+public:
+  Nv12Scaler(int src_width, int src_height, int dst_width, int dst_height);
+  void scale(const uint8_t *src_y, int src_stride_y, const uint8_t *src_uv, int src_stride_uv,
+             uint8_t *dst_y, int dst_stride_y, uint8_t *dst_u, int dst_stride_u, uint8_t *dst_v, int dst_stride_v) const;
+
+  // scales into contiguous I420 planes of dst_width x dst_height
+  inline void scale(const uint8_t *src_y, const uint8_t *src_uv, int src_stride, uint8_t *dst) const {
+    uint8_t *dst_u = dst + dst_width * dst_height;
+    uint8_t *dst_v = dst_u + (dst_width / 2) * (dst_height / 2);
+    scale(src_y, src_stride, src_uv, src_stride, dst, dst_width, dst_u, dst_width / 2, dst_v, dst_width / 2);
+  }
+
+private:
+  struct Plane {
+    Plane(int src_width, int src_height, int dst_width, int dst_height);
+    std::vector<int> cols, rows;  // source column and row of every destination column and row
+    int step = 0;                 // constant column step, if the vectorized rows apply
+  };
+
+  const int dst_width, dst_height;
+  const Plane y, uv;
+};
@@ -0,0 +1,35 @@
+// Time of Nv12Scaler against the NV12ToI420 + I420Scale chain it replaces, for the qcamera and thumbnail sizes.
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "common/nv12_scale.h"
+#include "common/timing.h"
+#include "third_party/libyuv/include/libyuv.h"
+
+int main() {
+  const int sw = 1928, sh = 1208, stride = 2048, n = 1000;
+  std::vector<uint8_t> y(stride * sh, 0x80), uv(stride * sh / 2, 0x80), conv(sw * sh * 3 / 2);
+  uint8_t *cy = conv.data(), *cu = cy + sw * sh, *cv = cu + sw * sh / 4;
+
+  for (auto [dw, dh] : {std::pair{526, 330}, std::pair{482, 302}}) {
+    std::vector<uint8_t> out(dw * dh * 3 / 2);
+    uint8_t *oy = out.data(), *ou = oy + dw * dh, *ov = ou + dw * dh / 4;
+
+    double t = millis_since_boot();
+    for (int i = 0; i < n; ++i) {
+      libyuv::NV12ToI420(y.data(), stride, uv.data(), stride, cy, sw, cu, sw / 2, cv, sw / 2, sw, sh);
+      libyuv::I420Scale(cy, sw, cu, sw / 2, cv, sw / 2, sw, sh, oy, dw, ou, dw / 2, ov, dw / 2, dw, dh, libyuv::kFilterNone);
+    }
+    const double two_pass = (millis_since_boot() - t) / n;
+
+    Nv12Scaler scaler(sw, sh, dw, dh);
+    t = millis_since_boot();
+    for (int i = 0; i < n; ++i) {
+      scaler.scale(y.data(), uv.data(), stride, out.data());
+    }
+    const double fused = (millis_since_boot() - t) / n;
+    printf("%dx%d -> %dx%d: two pass %.3f ms, fused %.3f ms (%.1fx)\n", sw, sh, dw, dh, two_pass, fused, two_pass / fused);
+  }
+  return 0;
+}
@@ -0,0 +1,38 @@
+#include <random>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "common/nv12_scale.h"
+#include "third_party/libyuv/include/libyuv.h"
+
+// the two pass conversion the scaler replaces
+static std::vector<uint8_t> libyuv_scale(const uint8_t *y, const uint8_t *uv, int stride, int sw, int sh, int dw, int dh) {
+  std::vector<uint8_t> conv(sw * sh * 3 / 2), out(dw * dh * 3 / 2);
+  uint8_t *cy = conv.data(), *cu = cy + sw * sh, *cv = cu + sw * sh / 4;
+  libyuv::NV12ToI420(y, stride, uv, stride, cy, sw, cu, sw / 2, cv, sw / 2, sw, sh);
+  uint8_t *oy = out.data(), *ou = oy + dw * dh, *ov = ou + dw * dh / 4;
+  libyuv::I420Scale(cy, sw, cu, sw / 2, cv, sw / 2, sw, sh, oy, dw, ou, dw / 2, ov, dw / 2, dw, dh, libyuv::kFilterNone);
+  return out;
+}
+
+TEST_CASE("Nv12Scaler matches libyuv") {
+  // qcamera, thumbnails, libyuv's special cased ratios, an unchanged width and the fallback for odd ratios
+  auto [sw, sh, dw, dh, stride] = GENERATE(std::make_tuple(1928, 1208, 526, 330, 2048),
+                                           std::make_tuple(1928, 1208, 482, 302, 2048),
+                                           std::make_tuple(1344, 760, 336, 190, 1344),
+                                           std::make_tuple(1928, 1208, 964, 604, 1928),
+                                           std::make_tuple(1928, 1208, 1446, 906, 1928),
+                                           std::make_tuple(64, 64, 24, 24, 64),
+                                           std::make_tuple(1920, 1088, 720, 408, 1920),
+                                           std::make_tuple(1928, 1208, 1928, 604, 2048),
+                                           std::make_tuple(100, 50, 100, 18, 100),
+                                           std::make_tuple(100, 50, 34, 18, 100));
+  std::mt19937 rng(sw * dw);
+  std::vector<uint8_t> y(stride * sh), uv(stride * sh / 2);
+  for (auto &b : y) b = rng();
+  for (auto &b : uv) b = rng();
+
+  std::vector<uint8_t> out(dw * dh * 3 / 2);
+  Nv12Scaler(sw, sh, dw, dh).scale(y.data(), uv.data(), stride, out.data());
+  REQUIRE(out == libyuv_scale(y.data(), uv.data(), stride, sw, sh, dw, dh));
+}
@@ -1,14 +1,51 @@
+#include <cstring>
+
 #include "opendbc/can/common.h"
 
+// Number of bytes consumed per step by the slice-by-N CRC loops below
+#define CRC_SLICES 8
+static_assert(CRC_SLICES == 8, "crc8_slice and crc16_slice are unrolled for eight bytes");
+
+static inline uint64_t load_u64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Sum of n bytes, eight at a time: add adjacent bytes into 16-bit lanes, then sum the lanes with a multiply.
+static inline unsigned int byte_sum(const uint8_t *p, size_t n) {
+  unsigned int s = 0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t w = load_u64(p + i);
+    w = (w & 0x00FF00FF00FF00FFULL) + ((w >> 8) & 0x00FF00FF00FF00FFULL);
+    s += (w * 0x0001000100010001ULL) >> 48;
+  }
+  for (; i < n; i++) { s += p[i]; }
+  return s;
+}
+
+// Sum of both nibbles of n bytes, eight bytes at a time. Each byte lane holds at most 30 after
+// adding the nibbles, so the horizontal sum through the multiply never carries between lanes.
+static inline unsigned int nibble_sum(const uint8_t *p, size_t n) {
+  unsigned int s = 0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t w = load_u64(p + i);
+    w = (w & 0x0F0F0F0F0F0F0F0FULL) + ((w >> 4) & 0x0F0F0F0F0F0F0F0FULL);
+    s += (w * 0x0101010101010101ULL) >> 56;
+  }
+  for (; i < n; i++) { s += (p[i] & 0xF) + (p[i] >> 4); }
+  return s;
+}
 
 unsigned int honda_checksum(uint32_t address, const Signal &sig, const std::vector<uint8_t> &d) {
   int s = 0;
   bool extended = address > 0x7FF;
   while (address) { s += (address & 0xF); address >>= 4; }
-  for (int i = 0; i < d.size(); i++) {
-    uint8_t x = d[i];
-    if (i == d.size()-1) x >>= 4; // remove checksum
-    s += (x & 0xF) + (x >> 4);
+  if (!d.empty()) {
+    s += nibble_sum(d.data(), d.size() - 1);
+    s += d.back() >> 4; // remove checksum
   }
   s = 8-s;
   if (extended) s += 3;  // extended can
@@ -19,7 +56,7 @@ unsigned int honda_checksum(uint32_t address, const Signal &sig, const std::vect
 unsigned int toyota_checksum(uint32_t address, const Signal &sig, const std::vector<uint8_t> &d) {
   unsigned int s = d.size();
   while (address) { s += address & 0xFF; address >>= 8; }
-  for (int i = 0; i < d.size() - 1; i++) { s += d[i]; }
+  if (!d.empty()) { s += byte_sum(d.data(), d.size() - 1); }
 
   return s & 0xFF;
 }
@@ -29,45 +66,17 @@ unsigned int subaru_checksum(uint32_t address, const Signal &sig, const std::vec
   while (address) { s += address & 0xFF; address >>= 8; }
 
   // skip checksum in first byte
-  for (int i = 1; i < d.size(); i++) { s += d[i]; }
+  if (d.size() > 1) { s += byte_sum(d.data() + 1, d.size() - 1); }
 
   return s & 0xFF;
 }
 
-unsigned int chrysler_checksum(uint32_t address, const Signal &sig, const std::vector<uint8_t> &d) {
-  // jeep chrysler canbus checksum from http://illmatics.com/Remote%20Car%20Hacking.pdf
-  uint8_t checksum = 0xFF;
-  for (int j = 0; j < (d.size() - 1); j++) {
-    uint8_t shift = 0x80;
-    uint8_t curr = d[j];
-    for (int i = 0; i < 8; i++) {
-      uint8_t bit_sum = curr & shift;
-      uint8_t temp_chk = checksum & 0x80U;
-      if (bit_sum != 0U) {
-        bit_sum = 0x1C;
-        if (temp_chk != 0U) {
-          bit_sum = 1;
-        }
-        checksum = checksum << 1;
-        temp_chk = checksum | 1U;
-        bit_sum ^= temp_chk;
-      } else {
-        if (temp_chk != 0U) {
-          bit_sum = 0x1D;
-        }
-        checksum = checksum << 1;
-        bit_sum ^= checksum;
-      }
-      checksum = bit_sum;
-      shift = shift >> 1;
-    }
-  }
-  return ~checksum & 0xFF;
-}
-
-// Static lookup table for fast computation of CRCs
-uint8_t crc8_lut_8h2f[256]; // CRC8 poly 0x2F, aka 8H2F/AUTOSAR
-uint16_t crc16_lut_xmodem[256]; // CRC16 poly 0x1021, aka XMODEM
+// Static lookup tables for fast computation of CRCs. lut[k][i] is the CRC of byte i followed by
+// k zero bytes, which lets the CRC loops consume CRC_SLICES bytes per step.
+uint8_t crc8_lut_8h2f[CRC_SLICES][256]; // CRC8 poly 0x2F, aka 8H2F/AUTOSAR
+uint8_t crc8_lut_j1850[256]; // CRC8 poly 0x1D, aka SAE J1850
+uint8_t crc8_lut_d5[256]; // CRC8 poly 0xD5
+uint16_t crc16_lut_xmodem[CRC_SLICES][256]; // CRC16 poly 0x1021, aka XMODEM
 
 void gen_crc_lookup_table_8(uint8_t poly, uint8_t crc_lut[]) {
   uint8_t crc;
@@ -102,16 +111,67 @@ void gen_crc_lookup_table_16(uint16_t poly, uint16_t crc_lut[]) {
   }
 }
 
+void gen_crc_slice_tables_8(uint8_t poly, uint8_t crc_lut[][256]) {
+  gen_crc_lookup_table_8(poly, crc_lut[0]);
+  for (int k = 1; k < CRC_SLICES; k++) {
+    for (int i = 0; i < 256; i++) {
+      crc_lut[k][i] = crc_lut[0][crc_lut[k - 1][i]];
+    }
+  }
+}
+
+void gen_crc_slice_tables_16(uint16_t poly, uint16_t crc_lut[][256]) {
+  gen_crc_lookup_table_16(poly, crc_lut[0]);
+  for (int k = 1; k < CRC_SLICES; k++) {
+    for (int i = 0; i < 256; i++) {
+      uint16_t crc = crc_lut[k - 1][i];
+      crc_lut[k][i] = (crc << 8) ^ crc_lut[0][crc >> 8];
+    }
+  }
+}
+
 // Initializes CRC lookup tables at module initialization
 struct CrcInitializer {
   CrcInitializer() {
-    gen_crc_lookup_table_8(0x2F, crc8_lut_8h2f);    // CRC-8 8H2F/AUTOSAR for Volkswagen
-    gen_crc_lookup_table_16(0x1021, crc16_lut_xmodem);    // CRC-16 XMODEM for HKG CAN FD
+    gen_crc_slice_tables_8(0x2F, crc8_lut_8h2f);    // CRC-8 8H2F/AUTOSAR for Volkswagen
+    gen_crc_lookup_table_8(0x1D, crc8_lut_j1850);    // CRC-8 SAE J1850 for Chrysler
+    gen_crc_lookup_table_8(0xD5, crc8_lut_d5);    // CRC-8 0xD5 for the comma pedal and body
+    gen_crc_slice_tables_16(0x1021, crc16_lut_xmodem);    // CRC-16 XMODEM for HKG CAN FD
   }
 };
 
 static CrcInitializer crcInitializer;
 
+static inline uint8_t crc8_slice(const uint8_t lut[][256], uint8_t crc, const uint8_t *p, size_t n) {
+  size_t i = 0;
+  for (; i + CRC_SLICES <= n; i += CRC_SLICES) {
+    crc = lut[7][crc ^ p[i]] ^ lut[6][p[i + 1]] ^ lut[5][p[i + 2]] ^ lut[4][p[i + 3]] ^
+          lut[3][p[i + 4]] ^ lut[2][p[i + 5]] ^ lut[1][p[i + 6]] ^ lut[0][p[i + 7]];
+  }
+  for (; i < n; i++) { crc = lut[0][crc ^ p[i]]; }
+  return crc;
+}
+
+static inline uint16_t crc16_slice(const uint16_t lut[][256], uint16_t crc, const uint8_t *p, size_t n) {
+  size_t i = 0;
+  for (; i + CRC_SLICES <= n; i += CRC_SLICES) {
+    crc = lut[7][p[i] ^ (crc >> 8)] ^ lut[6][p[i + 1] ^ (crc & 0xFF)] ^ lut[5][p[i + 2]] ^ lut[4][p[i + 3]] ^
+          lut[3][p[i + 4]] ^ lut[2][p[i + 5]] ^ lut[1][p[i + 6]] ^ lut[0][p[i + 7]];
+  }
+  for (; i < n; i++) { crc = (crc << 8) ^ lut[0][(crc >> 8) ^ p[i]]; }
+  return crc;
+}
+
+unsigned int chrysler_checksum(uint32_t address, const Signal &sig, const std::vector<uint8_t> &d) {
+  // jeep chrysler canbus checksum from http://illmatics.com/Remote%20Car%20Hacking.pdf
+  // this is a standard CRC8 SAE J1850 over all but the last byte
+  uint8_t checksum = 0xFF;
+  for (int j = 0; j < (int)d.size() - 1; j++) {
+    checksum = crc8_lut_j1850[checksum ^ d[j]];
+  }
+  return ~checksum & 0xFF;
+}
+
 unsigned int volkswagen_mqb_checksum(uint32_t address, const Signal &sig, const std::vector<uint8_t> &d) {
   // Volkswagen uses standard CRC8 8H2F/AUTOSAR, but they compute it with
   // a magic variable padding byte tacked onto the end of the payload.
@@ -120,9 +180,8 @@ unsigned int volkswagen_mqb_checksum(uint32_t address, const Signal &sig, const
   uint8_t crc = 0xFF; // Standard init value for CRC8 8H2F/AUTOSAR
 
   // CRC the payload first, skipping over the first byte where the CRC lives.
-  for (int i = 1; i < d.size(); i++) {
-    crc ^= d[i];
-    crc = crc8_lut_8h2f[crc];
+  if (d.size() > 1) {
+    crc = crc8_slice(crc8_lut_8h2f, crc, d.data() + 1, d.size() - 1);
   }
 
   // Look up and apply the magic final CRC padding byte, which permutes by CAN
@@ -188,20 +247,27 @@ unsigned int volkswagen_mqb_checksum(uint32_t address, const Signal &sig, const
       crc ^= (uint8_t[]){0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}[counter];
       break;
   }
-  crc = crc8_lut_8h2f[crc];
+  crc = crc8_lut_8h2f[0][crc];
 
   return crc ^ 0xFF; // Return after standard final XOR for CRC8 8H2F/AUTOSAR
 }
 
 unsigned int xor_checksum(uint32_t address, const Signal &sig, const std::vector<uint8_t> &d) {
-  uint8_t checksum = 0;
   int checksum_byte = sig.start_bit / 8;
 
   // Simple XOR over the payload, except for the byte where the checksum lives.
-  for (int i = 0; i < d.size(); i++) {
-    if (i != checksum_byte) {
-      checksum ^= d[i];
-    }
+  // XOR eight bytes at a time and fold, then take the checksum byte back out.
+  uint64_t acc = 0;
+  size_t i = 0;
+  for (; i + 8 <= d.size(); i += 8) { acc ^= load_u64(d.data() + i); }
+  acc ^= acc >> 32;
+  acc ^= acc >> 16;
+  acc ^= acc >> 8;
+
+  uint8_t checksum = acc & 0xFF;
+  for (; i < d.size(); i++) { checksum ^= d[i]; }
+  if (checksum_byte >= 0 && checksum_byte < d.size()) {
+    checksum ^= d[checksum_byte];
   }
 
   return checksum;
@@ -209,18 +275,10 @@ unsigned int xor_checksum(uint32_t address, const Signal &sig, const std::vector
 
 unsigned int pedal_checksum(uint32_t address, const Signal &sig, const std::vector<uint8_t> &d) {
   uint8_t crc = 0xFF;
-  uint8_t poly = 0xD5; // standard crc8
 
   // skip checksum byte
-  for (int i = d.size()-2; i >= 0; i--) {
-    crc ^= d[i];
-    for (int j = 0; j < 8; j++) {
-      if ((crc & 0x80) != 0) {
-        crc = (uint8_t)((crc << 1) ^ poly);
-      } else {
-        crc <<= 1;
-      }
-    }
+  for (int i = (int)d.size()-2; i >= 0; i--) {
+    crc = crc8_lut_d5[crc ^ d[i]];
   }
   return crc;
 }
@@ -228,13 +286,13 @@ unsigned int pedal_checksum(uint32_t address, const Signal &sig, const std::vect
 unsigned int hkg_can_fd_checksum(uint32_t address, const Signal &sig, const std::vector<uint8_t> &d) {
   uint16_t crc = 0;
 
-  for (int i = 2; i < d.size(); i++) {
-    crc = (crc << 8) ^ crc16_lut_xmodem[(crc >> 8) ^ d[i]];
+  if (d.size() > 2) {
+    crc = crc16_slice(crc16_lut_xmodem, crc, d.data() + 2, d.size() - 2);
   }
 
   // Add address to crc
-  crc = (crc << 8) ^ crc16_lut_xmodem[(crc >> 8) ^ ((address >> 0) & 0xFF)];
-  crc = (crc << 8) ^ crc16_lut_xmodem[(crc >> 8) ^ ((address >> 8) & 0xFF)];
+  crc = (crc << 8) ^ crc16_lut_xmodem[0][(crc >> 8) ^ ((address >> 0) & 0xFF)];
+  crc = (crc << 8) ^ crc16_lut_xmodem[0][(crc >> 8) ^ ((address >> 8) & 0xFF)];
 
   if (d.size() == 8) {
     crc ^= 0x5f29;
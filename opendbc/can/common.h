@@ -64,6 +64,8 @@ private:
 
   const DBC *dbc = NULL;
   std::unordered_map<uint32_t, MessageState> message_states;
+  std::vector<MessageState *> queried_states;  // all_vals are cleared before the next update
+  void clear_queried();
 
 public:
   bool can_valid = false;
@@ -80,21 +82,41 @@ public:
   #ifndef DYNAMIC_CAPNP
   void update_string(const std::string &data, bool sendcan);
   void update_strings(const std::vector<std::string> &data, std::vector<SignalValue> &vals, bool sendcan);
+  void update_strings(const std::vector<std::string> &data, std::vector<const MessageState *> &states, bool sendcan);
   void UpdateCans(uint64_t nanos, const capnp::List<cereal::CanData>::Reader& cans);
   #endif
   void UpdateCans(uint64_t nanos, const capnp::DynamicStruct::Reader& cans);
   void UpdateValid(uint64_t nanos);
   void query_latest(std::vector<SignalValue> &vals, uint64_t last_ts = 0);
+  // Zero-copy alternative to query_latest. Returns the updated messages, whose signals are read in place
+  // by index: vals[i] is the latest value and all_vals[i] all values since the last query of parse_sigs[i].
+  // The MessageStates are stable for the lifetime of the parser, all_vals stay valid until the next update.
+  void query_latest(std::vector<const MessageState *> &states, uint64_t last_ts = 0);
+};
+
+// A message's signal set resolved once by CANPacker::prepare. Values passed to
+// CANPacker::pack are indexed by the position of the signal name given to prepare.
+struct PackPlan {
+  uint32_t address = 0;
+  unsigned int size = 0;
+  std::vector<const Signal*> sigs;
+  const Signal *counter_sig = nullptr;
+  const Signal *checksum_sig = nullptr;
+  int counter_handle = -1;  // index of COUNTER in sigs, if set by the caller
+  uint32_t *counter = nullptr;  // points into CANPacker::counters
+  std::vector<uint8_t> dat;  // scratch buffer for the checksum functions
 };
 
 class CANPacker {
 private:
   const DBC *dbc = NULL;
   std::map<std::pair<uint32_t, std::string>, Signal> signal_lookup;
-  std::map<uint32_t, uint32_t> counters;
+  std::unordered_map<uint32_t, uint32_t> counters;
 
 public:
   CANPacker(const std::string& dbc_name);
   std::vector<uint8_t> pack(uint32_t address, const std::vector<SignalPackValue> &values);
+  PackPlan prepare(uint32_t address, const std::vector<std::string> &signal_names);
+  void pack(PackPlan &plan, const double *values, uint8_t *out);
   const Msg* lookup_message(uint32_t address);
 };
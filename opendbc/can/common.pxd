@@ -67,12 +67,25 @@ cdef extern from "common_dbc.h":
 cdef extern from "common.h":
   cdef const DBC* dbc_lookup(const string) except +
 
+  cdef cppclass MessageState:
+    uint32_t address
+    uint64_t last_seen_nanos
+    vector[double] vals
+    vector[vector[double]] all_vals
+
   cdef cppclass CANParser:
     bool can_valid
     bool bus_timeout
     CANParser(int, string, vector[pair[uint32_t, int]]) except +
     void update_strings(vector[string]&, vector[SignalValue]&, bool) except +
+    void update_strings(vector[string]&, vector[const MessageState*]&, bool) except +
+
+  cdef cppclass PackPlan:
+    uint32_t address
+    unsigned int size
 
   cdef cppclass CANPacker:
    CANPacker(string)
    vector[uint8_t] pack(uint32_t, vector[SignalPackValue]&)
+   PackPlan prepare(uint32_t, vector[string]&) except +
+   void pack(PackPlan&, const double*, uint8_t*)
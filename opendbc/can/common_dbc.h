@@ -5,6 +5,8 @@
 #include <unordered_map>
 #include <vector>
 
+#include "opendbc/can/signal_extractor.h"
+
 struct SignalPackValue {
   std::string name;
   double value;
@@ -39,6 +41,7 @@ struct Signal {
   bool is_little_endian;
   SignalType type;
   unsigned int (*calc_checksum)(uint32_t address, const Signal &sig, const std::vector<uint8_t> &d);
+  SignalExtractor extractor;
 };
 
 struct Msg {
@@ -1,21 +1,23 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstring>
 #include <map>
 #include <stdexcept>
+#include <sstream>
 #include <utility>
 
 #include "opendbc/can/common.h"
 
 
-void set_value(std::vector<uint8_t> &msg, const Signal &sig, int64_t ival) {
+void set_value(uint8_t *msg, size_t msg_size, const Signal &sig, int64_t ival) {
   int i = sig.lsb / 8;
   int bits = sig.size;
   if (sig.size < 64) {
     ival &= ((1ULL << sig.size) - 1);
   }
 
-  while (i >= 0 && i < msg.size() && bits > 0) {
+  while (i >= 0 && i < msg_size && bits > 0) {
     int shift = (int)(sig.lsb / 8) == i ? sig.lsb % 8 : 0;
     int size = std::min(bits, 8 - shift);
 
@@ -28,6 +30,18 @@ void set_value(std::vector<uint8_t> &msg, const Signal &sig, int64_t ival) {
   }
 }
 
+void set_value(std::vector<uint8_t> &msg, const Signal &sig, int64_t ival) {
+  set_value(msg.data(), msg.size(), sig, ival);
+}
+
+static inline int64_t to_raw_value(const Signal &sig, double value) {
+  int64_t ival = (int64_t)(round((value - sig.offset) / sig.factor));
+  if (ival < 0) {
+    ival = (1ULL << sig.size) + ival;
+  }
+  return ival;
+}
+
 CANPacker::CANPacker(const std::string& dbc_name) {
   dbc = dbc_lookup(dbc_name);
   assert(dbc);
@@ -58,12 +72,7 @@ std::vector<uint8_t> CANPacker::pack(uint32_t address, const std::vector<SignalP
       continue;
     }
     const auto &sig = sig_it->second;
-
-    int64_t ival = (int64_t)(round((sigval.value - sig.offset) / sig.factor));
-    if (ival < 0) {
-      ival = (1ULL << sig.size) + ival;
-    }
-    set_value(ret, sig, ival);
+    set_value(ret, sig, to_raw_value(sig, sigval.value));
 
     if (sigval.name == "COUNTER") {
       counters[address] = sigval.value;
@@ -96,6 +105,71 @@ std::vector<uint8_t> CANPacker::pack(uint32_t address, const std::vector<SignalP
   return ret;
 }
 
+PackPlan CANPacker::prepare(uint32_t address, const std::vector<std::string> &signal_names) {
+  auto msg_it = dbc->addr_to_msg.find(address);
+  if (msg_it == dbc->addr_to_msg.end()) {
+    std::stringstream is;
+    is << "undefined address " << address;
+    throw std::runtime_error(is.str());
+  }
+  const Msg *msg = msg_it->second;
+
+  PackPlan plan;
+  plan.address = address;
+  plan.size = msg->size;
+  plan.dat.resize(msg->size);
+
+  auto find_signal = [msg](const std::string &name) -> const Signal* {
+    auto it = std::find_if(msg->sigs.begin(), msg->sigs.end(), [&](const Signal &s) { return s.name == name; });
+    return it != msg->sigs.end() ? &(*it) : nullptr;
+  };
+
+  for (const auto &name : signal_names) {
+    const Signal *sig = find_signal(name);
+    if (sig == nullptr) {
+      std::stringstream is;
+      is << "undefined signal " << name << " - " << address;
+      throw std::runtime_error(is.str());
+    }
+    if (name == "COUNTER") {
+      plan.counter_handle = plan.sigs.size();
+    }
+    plan.sigs.push_back(sig);
+  }
+
+  plan.counter_sig = find_signal("COUNTER");
+  plan.checksum_sig = find_signal("CHECKSUM");
+  if (plan.checksum_sig != nullptr && plan.checksum_sig->calc_checksum == nullptr) {
+    plan.checksum_sig = nullptr;
+  }
+  // shared with the string-keyed pack(), element pointers are stable across rehashes
+  plan.counter = &counters[address];
+  return plan;
+}
+
+void CANPacker::pack(PackPlan &plan, const double *values, uint8_t *out) {
+  memset(out, 0, plan.size);
+
+  for (int i = 0; i < plan.sigs.size(); i++) {
+    set_value(out, plan.size, *plan.sigs[i], to_raw_value(*plan.sigs[i], values[i]));
+  }
+
+  // set message counter
+  if (plan.counter_handle >= 0) {
+    *plan.counter = values[plan.counter_handle];
+  } else if (plan.counter_sig != nullptr) {
+    set_value(out, plan.size, *plan.counter_sig, *plan.counter);
+    *plan.counter = (*plan.counter + 1) % (1 << plan.counter_sig->size);
+  }
+
+  // set message checksum
+  if (plan.checksum_sig != nullptr) {
+    memcpy(plan.dat.data(), out, plan.size);
+    unsigned int checksum = plan.checksum_sig->calc_checksum(plan.address, *plan.checksum_sig, plan.dat);
+    set_value(out, plan.size, *plan.checksum_sig, checksum);
+  }
+}
+
 // This function has a definition in common.h and is used in PlotJuggler
 const Msg* CANPacker::lookup_message(uint32_t address) {
   return dbc->addr_to_msg.at(address);
@@ -2,12 +2,26 @@
 # cython: c_string_encoding=ascii, language_level=3
 
 from libc.stdint cimport uint8_t, uint32_t
+from libcpp.string cimport string
 from libcpp.vector cimport vector
 
 from .common cimport CANPacker as cpp_CANPacker
+from .common cimport PackPlan as cpp_PackPlan
 from .common cimport dbc_lookup, SignalPackValue, DBC, Msg
 
 
+cdef class PackPlan:
+  cdef:
+    cpp_PackPlan plan
+    vector[double] values
+    vector[uint8_t] dat
+    object packer  # plan references the packer's counter state
+
+  cdef readonly:
+    uint32_t address
+    tuple signal_names
+
+
 cdef class CANPacker:
   cdef:
     cpp_CANPacker *packer
@@ -51,3 +65,43 @@ cdef class CANPacker:
 
     cdef vector[uint8_t] val = self.pack(addr, values)
     return [addr, 0, (<char *>&val[0])[:val.size()], bus]
+
+  def prepare(self, name_or_addr, signal_names):
+    """Resolve a message's signals once. Pass the returned plan to make_can_msg_prepared
+    with values in the same order as signal_names."""
+    cdef uint32_t addr = 0
+    cdef const Msg* m
+    if isinstance(name_or_addr, int):
+      addr = name_or_addr
+    else:
+      try:
+        m = self.dbc.name_to_msg.at(name_or_addr.encode("utf8"))
+        addr = m.address
+      except IndexError:
+        raise RuntimeError(f"could not find message {repr(name_or_addr)} in DBC")
+
+    cdef vector[string] names
+    for name in signal_names:
+      names.push_back(name.encode("utf8"))
+
+    cdef PackPlan plan = PackPlan.__new__(PackPlan)
+    plan.plan = self.packer.prepare(addr, names)
+    plan.values.resize(names.size())
+    plan.dat.resize(plan.plan.size)
+    plan.packer = self
+    plan.address = addr
+    plan.signal_names = tuple(signal_names)
+    return plan
+
+  cpdef make_can_msg_prepared(self, PackPlan plan, bus, values):
+    if plan.packer is not self:
+      raise ValueError("plan was prepared by a different CANPacker")
+    if len(values) != plan.values.size():
+      raise ValueError(f"expected {plan.values.size()} values, got {len(values)}")
+
+    cdef int i
+    for i in range(plan.values.size()):
+      plan.values[i] = values[i]
+
+    self.packer.pack(plan.plan, plan.values.data(), plan.dat.data())
+    return [plan.address, 0, (<char *>plan.dat.data())[:plan.dat.size()], bus]
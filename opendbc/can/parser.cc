@@ -13,22 +13,7 @@
 #include "opendbc/can/common.h"
 
 int64_t get_raw_value(const std::vector<uint8_t> &msg, const Signal &sig) {
-  int64_t ret = 0;
-
-  int i = sig.msb / 8;
-  int bits = sig.size;
-  while (i >= 0 && i < msg.size() && bits > 0) {
-    int lsb = (int)(sig.lsb / 8) == i ? sig.lsb : i*8;
-    int msb = (int)(sig.msb / 8) == i ? sig.msb : (i+1)*8 - 1;
-    int size = msb - lsb + 1;
-
-    uint64_t d = (msg[i] >> (lsb - (i*8))) & ((1ULL << size) - 1);
-    ret |= d << (bits - size);
-
-    bits -= size;
-    i = sig.is_little_endian ? i-1 : i+1;
-  }
-  return ret;
+  return sig.extractor.raw(msg.data(), msg.size());
 }
 
 
@@ -157,8 +142,20 @@ CANParser::CANParser(int abus, const std::string& dbc_name, bool ignore_checksum
   }
 }
 
+void CANParser::clear_queried() {
+  // values handed out by the zero-copy query_latest are consumed now
+  for (auto state : queried_states) {
+    for (auto &vals : state->all_vals) {
+      vals.clear();
+    }
+  }
+  queried_states.clear();
+}
+
 #ifndef DYNAMIC_CAPNP
 void CANParser::update_string(const std::string &data, bool sendcan) {
+  clear_queried();
+
   // format for board, make copy due to alignment issues.
   const size_t buf_size = (data.length() / sizeof(capnp::word)) + 1;
   if (aligned_buf.size() < buf_size) {
@@ -192,6 +189,19 @@ void CANParser::update_strings(const std::vector<std::string> &data, std::vector
   query_latest(vals, current_nanos);
 }
 
+void CANParser::update_strings(const std::vector<std::string> &data, std::vector<const MessageState *> &states, bool sendcan) {
+  clear_queried();
+
+  uint64_t current_nanos = 0;
+  for (const auto &d : data) {
+    update_string(d, sendcan);
+    if (current_nanos == 0) {
+      current_nanos = last_nanos;
+    }
+  }
+  query_latest(states, current_nanos);
+}
+
 void CANParser::UpdateCans(uint64_t nanos, const capnp::List<cereal::CanData>::Reader& cans) {
   //DEBUG("got %d messages\n", cans.size());
 
@@ -313,3 +323,17 @@ void CANParser::query_latest(std::vector<SignalValue> &vals, uint64_t last_ts) {
     }
   }
 }
+
+void CANParser::query_latest(std::vector<const MessageState *> &states, uint64_t last_ts) {
+  if (last_ts == 0) {
+    last_ts = last_nanos;
+  }
+  for (auto& kv : message_states) {
+    auto& state = kv.second;
+    if (last_ts != 0 && state.last_seen_nanos < last_ts) {
+      continue;
+    }
+    states.push_back(&state);
+    queried_states.push_back(&state);
+  }
+}
@@ -1,14 +1,13 @@
 # distutils: language = c++
 # cython: c_string_encoding=ascii, language_level=3
 
-from cython.operator cimport dereference as deref, preincrement as preinc
 from libcpp.pair cimport pair
 from libcpp.string cimport string
 from libcpp.vector cimport vector
 from libc.stdint cimport uint32_t
 
 from .common cimport CANParser as cpp_CANParser
-from .common cimport dbc_lookup, SignalValue, DBC
+from .common cimport dbc_lookup, MessageState, DBC
 
 import numbers
 from collections import defaultdict
@@ -18,8 +17,8 @@ cdef class CANParser:
   cdef:
     cpp_CANParser *can
     const DBC *dbc
-    vector[SignalValue] can_values
     vector[uint32_t] addresses
+    dict signal_names
 
   cdef readonly:
     dict vl
@@ -36,6 +35,7 @@ cdef class CANParser:
     self.vl = {}
     self.vl_all = {}
     self.ts_nanos = {}
+    self.signal_names = {}
 
     # Convert message names into addresses and check existence in DBC
     cdef vector[pair[uint32_t, int]] message_v
@@ -57,6 +57,8 @@ cdef class CANParser:
       self.vl_all[name] = self.vl_all[address]
       self.ts_nanos[address] = {}
       self.ts_nanos[name] = self.ts_nanos[address]
+      # indexed like the parser's MessageState values
+      self.signal_names[address] = [m.sigs[j].name.decode("utf8") for j in range(m.sigs.size())]
 
     self.can = new cpp_CANParser(bus, dbc_name, message_v)
     self.update_strings([])
@@ -69,33 +71,23 @@ cdef class CANParser:
     for address in self.addresses:
       self.vl_all[address].clear()
 
-    cdef vector[SignalValue] new_vals
-    cur_address = -1
-    vl = {}
-    vl_all = {}
-    ts_nanos = {}
-    updated_addrs = set()
+    cdef vector[const MessageState*] updated
+    self.can.update_strings(strings, updated, sendcan)
 
-    self.can.update_strings(strings, new_vals, sendcan)
-    cdef vector[SignalValue].iterator it = new_vals.begin()
-    cdef SignalValue* cv
-    while it != new_vals.end():
-      cv = &deref(it)
-
-      # Check if the address has changed
-      if cv.address != cur_address:
-        cur_address = cv.address
-        vl = self.vl[cur_address]
-        vl_all = self.vl_all[cur_address]
-        ts_nanos = self.ts_nanos[cur_address]
-        updated_addrs.add(cur_address)
-
-      # Cast char * directly to unicode
-      cv_name = <unicode>cv.name
-      vl[cv_name] = cv.value
-      vl_all[cv_name] = cv.all_values
-      ts_nanos[cv_name] = cv.ts_nanos
-      preinc(it)
+    updated_addrs = set()
+    cdef const MessageState *state
+    cdef size_t i
+    for state in updated:
+      address = state.address
+      vl = self.vl[address]
+      vl_all = self.vl_all[address]
+      ts_nanos = self.ts_nanos[address]
+      updated_addrs.add(address)
+
+      for i, name in enumerate(self.signal_names[address]):
+        vl[name] = state.vals[i]
+        vl_all[name] = state.all_vals[i]
+        ts_nanos[name] = state.last_seen_nanos
 
     return updated_addrs
 
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define SIGNAL_EXTRACTOR_AVX2
+#endif
+
+// Precomputed extraction of a signal's raw value, shared by the CAN parser and cabana.
+// A signal that fits in one 8-byte window is read with a single load, shift and mask,
+// the others are walked byte by byte. Assumes a little endian host.
+class SignalExtractor {
+public:
+  SignalExtractor() = default;
+  SignalExtractor(int msb, int lsb, int size, bool is_little_endian)
+    : msb(msb), lsb(lsb), size(size), is_little_endian(is_little_endian) {
+    const int first = (is_little_endian ? lsb : msb) / 8;
+    const int last = (is_little_endian ? msb : lsb) / 8;
+    window = std::max(0, last - 7);
+    window_end = window + 8;
+    fast = size > 0 && size <= 64 && window <= first;
+    shift = is_little_endian ? lsb - window * 8 : 56 - (last - window) * 8 + lsb % 8;
+    mask = size >= 64 ? ~0ULL : (1ULL << size) - 1;
+  }
+
+  inline uint64_t raw(const uint8_t *data, size_t data_size) const {
+    if (fast && window_end <= data_size) {
+      return (load(data + window) >> shift) & mask;
+    }
+    return walk(data, data_size);
+  }
+
+  // raw values of one signal across n events, Event must have `dat` and `size` members
+  template <typename Event>
+  void raw(const Event *const *events, size_t n, uint64_t *out) const {
+    size_t i = 0;
+#ifdef SIGNAL_EXTRACTOR_AVX2
+    if (fast && has_avx2()) {
+      i = raw_avx2(events, n, out);
+    }
+#endif
+    for (; i < n; ++i) {
+      out[i] = raw(events[i]->dat, events[i]->size);
+    }
+  }
+
+  static inline int64_t sign_extend(uint64_t raw, int size) {
+    return size > 0 && size < 64 ? (int64_t)(raw << (64 - size)) >> (64 - size) : (int64_t)raw;
+  }
+
+private:
+  inline uint64_t load(const uint8_t *p) const {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return is_little_endian ? v : __builtin_bswap64(v);
+  }
+
+  uint64_t walk(const uint8_t *data, size_t data_size) const {
+    uint64_t ret = 0;
+    int i = msb / 8;
+    int bits = size;
+    while (i >= 0 && i < data_size && bits > 0) {
+      int lsb_ = (int)(lsb / 8) == i ? lsb : i*8;
+      int msb_ = (int)(msb / 8) == i ? msb : (i+1)*8 - 1;
+      int sz = msb_ - lsb_ + 1;
+
+      uint64_t d = (data[i] >> (lsb_ - (i*8))) & ((1ULL << sz) - 1);
+      ret |= d << (bits - sz);
+
+      bits -= sz;
+      i = is_little_endian ? i-1 : i+1;
+    }
+    return ret;
+  }
+
+#ifdef SIGNAL_EXTRACTOR_AVX2
+  static bool has_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+  }
+
+  // gathers the 8-byte windows of four events at a time, returns the number of events done
+  template <typename Event>
+  __attribute__((target("avx2"))) size_t raw_avx2(const Event *const *events, size_t n, uint64_t *out) const {
+    const __m256i vshift = _mm256_set1_epi64x(shift);
+    const __m256i vmask = _mm256_set1_epi64x(mask);
+    const __m256i bswap = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                           7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      const Event *e0 = events[i], *e1 = events[i + 1], *e2 = events[i + 2], *e3 = events[i + 3];
+      if (std::min({(size_t)e0->size, (size_t)e1->size, (size_t)e2->size, (size_t)e3->size}) < window_end) {
+        for (int j = 0; j < 4; ++j) {
+          out[i + j] = raw(events[i + j]->dat, events[i + j]->size);
+        }
+        continue;
+      }
+      const __m256i addr = _mm256_setr_epi64x((long long)(e0->dat + window), (long long)(e1->dat + window),
+                                              (long long)(e2->dat + window), (long long)(e3->dat + window));
+      __m256i v = _mm256_i64gather_epi64((const long long *)nullptr, addr, 1);
+      if (!is_little_endian) {
+        v = _mm256_shuffle_epi8(v, bswap);
+      }
+      v = _mm256_and_si256(_mm256_srlv_epi64(v, vshift), vmask);
+      _mm256_storeu_si256((__m256i *)(out + i), v);
+    }
+    return i;
+  }
+#endif
+
+  int msb = 0, lsb = 0, size = 0;
+  bool is_little_endian = true;
+  bool fast = false;
+  int window = 0, window_end = 0;  // bytes [window, window_end) hold the whole signal
+  int shift = 0;
+  uint64_t mask = 0;
+};
@@ -1,4 +1,5 @@
 #!/usr/bin/env python3
+import random
 import unittest
 
 from opendbc.can.parser import CANParser
@@ -6,6 +7,64 @@ from opendbc.can.packer import CANPacker
 from opendbc.can.tests.test_packer_parser import can_list_to_can_capnp
 
 
+# Straightforward reference implementations, the C++ checksums are table-driven and word-at-a-time
+def _crc8(poly, crc, data):
+  for b in data:
+    crc ^= b
+    for _ in range(8):
+      crc = ((crc << 1) ^ poly) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+  return crc
+
+
+def _crc16(poly, crc, data):
+  for b in data:
+    crc ^= b << 8
+    for _ in range(8):
+      crc = ((crc << 1) ^ poly) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+  return crc
+
+
+def honda_checksum(address, dat):
+  s = sum((address >> (4 * i)) & 0xF for i in range(8))
+  s += sum((b & 0xF) + (b >> 4) for b in dat[:-1]) + (dat[-1] >> 4)
+  s = 8 - s + (3 if address > 0x7FF else 0)
+  return s & 0xF
+
+
+def toyota_checksum(address, dat):
+  return (len(dat) + sum(address.to_bytes(4, "little")) + sum(dat[:-1])) & 0xFF
+
+
+def subaru_checksum(address, dat):
+  return (sum(address.to_bytes(4, "little")) + sum(dat[1:])) & 0xFF
+
+
+def chrysler_checksum(address, dat):
+  return ~_crc8(0x1D, 0xFF, dat[:-1]) & 0xFF
+
+
+def volkswagen_mqb_checksum(address, dat):
+  magic = {0x126: [0xDA] * 16}[address]
+  crc = _crc8(0x2F, 0xFF, dat[1:])
+  return _crc8(0x2F, crc, [magic[dat[1] & 0xF]]) ^ 0xFF
+
+
+def xor_checksum(address, dat):
+  checksum = 0
+  for b in dat[1:]:
+    checksum ^= b
+  return checksum
+
+
+def pedal_checksum(address, dat):
+  return _crc8(0xD5, 0xFF, reversed(dat[:-1]))
+
+
+def hkg_can_fd_checksum(address, dat):
+  crc = _crc16(0x1021, 0, list(dat[2:]) + [address & 0xFF, (address >> 8) & 0xFF])
+  return crc ^ {8: 0x5f29, 16: 0x041d, 24: 0x819d, 32: 0x9f5b}.get(len(dat), 0)
+
+
 class TestCanChecksums(unittest.TestCase):
 
   def test_honda_checksum(self):
@@ -37,6 +96,36 @@ class TestCanChecksums(unittest.TestCase):
       self.assertEqual(parser.vl['LKAS_HUD']['CHECKSUM'], std)
       self.assertEqual(parser.vl['LKAS_HUD_A']['CHECKSUM'], ext)
 
+  def test_checksums_random(self):
+    """Compare the C++ checksums with the reference implementations on randomly filled messages"""
+    tests = [
+      ("honda_accord_2018_can_generated", "LKAS_HUD", honda_checksum),
+      ("honda_accord_2018_can_generated", "LKAS_HUD_A", honda_checksum),
+      ("toyota_new_mc_pt_generated", "ACC_CONTROL", toyota_checksum),
+      ("subaru_global_2017_generated", "ES_LKAS", subaru_checksum),
+      ("chrysler_pacifica_2017_hybrid_generated", "DAS_3", chrysler_checksum),
+      ("vw_mqb_2010", "HCA_01", volkswagen_mqb_checksum),
+      ("vw_golf_mk4", "HCA_1", xor_checksum),
+      ("comma_body", "TORQUE_CMD", pedal_checksum),
+      ("hyundai_canfd", "LKAS", hkg_can_fd_checksum),
+      ("hyundai_canfd", "ADRV_0x51", hkg_can_fd_checksum),
+    ]
+    random.seed(0)
+    for dbc_file, msg_name, ref_checksum in tests:
+      with self.subTest(dbc=dbc_file, msg=msg_name):
+        parser = CANParser(dbc_file, [(msg_name, 0)], 0)
+        packer = CANPacker(dbc_file)
+
+        # parse once to learn the message's signal names
+        parser.update_strings([can_list_to_can_capnp([packer.make_can_msg(msg_name, 0, {})])])
+        signals = [s for s in parser.vl[msg_name] if s not in ("COUNTER", "CHECKSUM")]
+
+        for _ in range(200):
+          values = {s: random.randint(0, 2**16) for s in signals}
+          addr, _, dat, _ = msg = packer.make_can_msg(msg_name, 0, values)
+          parser.update_strings([can_list_to_can_capnp([msg])])
+          self.assertEqual(parser.vl[msg_name]["CHECKSUM"], ref_checksum(addr, dat))
+
 
 if __name__ == "__main__":
   unittest.main()
@@ -195,6 +195,28 @@ class TestCanParserPacker(unittest.TestCase):
         for sig in ("STEER_TORQUE", "STEER_TORQUE_REQUEST", "COUNTER", "CHECKSUM"):
           self.assertEqual(parser.vl["STEERING_CONTROL"][sig], parser.vl[228][sig])
 
+  def test_packer_prepared(self):
+    # prepared plans must produce the same bytes as the dict-based path, counter and checksum included
+    packer = CANPacker(TEST_DBC)
+    packer_prepared = CANPacker(TEST_DBC)
+    plan = packer_prepared.prepare("STEERING_CONTROL", ["STEER_TORQUE", "STEER_TORQUE_REQUEST"])
+
+    for steer in range(-256, 255):
+      for active in (1, 0):
+        expected = packer.make_can_msg("STEERING_CONTROL", 0, {"STEER_TORQUE": steer, "STEER_TORQUE_REQUEST": active})
+        self.assertEqual(packer_prepared.make_can_msg_prepared(plan, 0, [steer, active]), expected)
+
+    # setting COUNTER through a plan overrides the counter, and is shared with make_can_msg
+    plan = packer.prepare(245, ["COUNTER"])
+    self.assertEqual(packer.make_can_msg_prepared(plan, 0, [42])[2][0], 42)
+    self.assertEqual(packer.make_can_msg("CAN_FD_MESSAGE", 0, {})[2][0], 42)
+    self.assertEqual(packer.make_can_msg("CAN_FD_MESSAGE", 0, {})[2][0], 43)
+
+    with self.assertRaises(RuntimeError):
+      packer.prepare("STEERING_CONTROL", ["NOT_A_SIGNAL"])
+    with self.assertRaises(ValueError):
+      packer.make_can_msg_prepared(plan, 0, [])
+
   def test_scale_offset(self):
     """Test that both scale and offset are correctly preserved"""
     dbc_file = "honda_civic_touring_2016_can_generated"
@@ -11,6 +11,21 @@
 #include "common/util.h"
 
 Panda::Panda(std::string serial, uint32_t bus_offset) : bus_offset(bus_offset) {
+  if (serial.rfind("sim", 0) == 0) {
+    handle = std::make_unique<PandaSimHandle>(serial);
+    LOGW("connected to simulated panda %s", serial.c_str());
+  } else {
+    connect_hw(serial);
+  }
+
+  tx_max_size = handle->max_bulk_write_size();
+  hw_type = get_hw_type();
+  can_reset_communications();
+
+  return;
+}
+
+void Panda::connect_hw(const std::string &serial) {
   // try USB first, then SPI
   try {
     handle = std::make_unique<PandaUsbHandle>(serial);
@@ -23,11 +38,6 @@ Panda::Panda(std::string serial, uint32_t bus_offset) : bus_offset(bus_offset) {
     throw e;
 #endif
   }
-
-  hw_type = get_hw_type();
-  can_reset_communications();
-
-  return;
 }
 
 bool Panda::connected() {
@@ -43,6 +53,11 @@ std::string Panda::hw_serial() {
 }
 
 std::vector<std::string> Panda::list(bool usb_only) {
+  // PANDAD_SIM=<n> replaces the hardware with n simulated pandas
+  if (getenv("PANDAD_SIM") != NULL) {
+    return PandaSimHandle::list();
+  }
+
   std::vector<std::string> serials = PandaUsbHandle::list();
 
 #ifndef __APPLE__
@@ -99,6 +114,10 @@ std::optional<can_health_t> Panda::get_can_state(uint16_t can_number) {
   return err >= 0 ? std::make_optional(can_health) : std::nullopt;
 }
 
+std::optional<spi_stats_t> Panda::get_spi_stats() {
+  return handle->take_spi_stats();
+}
+
 void Panda::set_loopback(bool loopback) {
   handle->control_write(0xe5, loopback, 0);
 }
@@ -164,10 +183,11 @@ static uint8_t len_to_dlc(uint8_t len) {
   }
 }
 
-void Panda::pack_can_buffer(const capnp::List<cereal::CanData>::Reader &can_data_list,
-                            std::function<void(uint8_t *, size_t)> write_func) {
-  int32_t pos = 0;
-  uint8_t send_buf[2 * USB_TX_SOFT_LIMIT];
+template <typename CanDataList>
+void Panda::pack_frames(const CanDataList &can_data_list, const std::function<void(uint8_t *, size_t)> &write_func) {
+  send_buffer.resize(tx_max_size);
+  uint8_t *send_buf = send_buffer.data();
+  uint32_t pos = 0;
 
   for (auto cmsg : can_data_list) {
     // check if the message is intended for this panda
@@ -180,6 +200,13 @@ void Panda::pack_can_buffer(const capnp::List<cereal::CanData>::Reader &can_data
     assert(can_data.size() <= 64);
     assert(can_data.size() == dlc_to_len[data_len_code]);
 
+    // flush when the next packet doesn't fit, so every transfer is as large as possible
+    uint32_t msg_size = sizeof(can_header) + can_data.size();
+    if (pos + msg_size > tx_max_size) {
+      write_func(send_buf, pos);
+      pos = 0;
+    }
+
     can_header header = {};
     header.addr = cmsg.getAddress();
     header.extended = (cmsg.getAddress() >= 0x800) ? 1 : 0;
@@ -189,34 +216,44 @@ void Panda::pack_can_buffer(const capnp::List<cereal::CanData>::Reader &can_data
 
     memcpy(&send_buf[pos], (uint8_t *)&header, sizeof(can_header));
     memcpy(&send_buf[pos + sizeof(can_header)], (uint8_t *)can_data.begin(), can_data.size());
-    uint32_t msg_size = sizeof(can_header) + can_data.size();
 
     // set checksum
     ((can_header *) &send_buf[pos])->checksum = calculate_checksum(&send_buf[pos], msg_size);
 
     pos += msg_size;
-
-    if (pos >= USB_TX_SOFT_LIMIT) {
-      write_func(send_buf, pos);
-      pos = 0;
-    }
   }
 
   // send remaining packets
   if (pos > 0) write_func(send_buf, pos);
 }
 
+void Panda::pack_can_buffer(const capnp::List<cereal::CanData>::Reader &can_data_list,
+                            std::function<void(uint8_t *, size_t)> write_func) {
+  pack_frames(can_data_list, write_func);
+}
+
+void Panda::pack_can_buffer(const std::vector<cereal::CanData::Reader> &can_data_list,
+                            std::function<void(uint8_t *, size_t)> write_func) {
+  pack_frames(can_data_list, write_func);
+}
+
 void Panda::can_send(capnp::List<cereal::CanData>::Reader can_data_list) {
   pack_can_buffer(can_data_list, [=](uint8_t* data, size_t size) {
     handle->bulk_write(3, data, size, 5);
   });
 }
 
+void Panda::can_send(const std::vector<cereal::CanData::Reader> &can_data_list) {
+  pack_can_buffer(can_data_list, [=](uint8_t* data, size_t size) {
+    handle->bulk_write(3, data, size, 5);
+  });
+}
+
 bool Panda::can_receive(std::vector<can_frame>& out_vec) {
   // Check if enough space left in buffer to store RECV_SIZE data
-  assert(receive_buffer_size + RECV_SIZE <= sizeof(receive_buffer));
+  assert(rx_head - rx_tail + RECV_SIZE <= RECV_RING_SIZE);
 
-  int recv = handle->bulk_read(0x81, &receive_buffer[receive_buffer_size], RECV_SIZE);
+  int recv = handle->can_read(rx_write_ptr(), RECV_SIZE);
   if (!comms_healthy()) {
     return false;
   }
@@ -228,32 +265,42 @@ bool Panda::can_receive(std::vector<can_frame>& out_vec) {
 
   bool ret = true;
   if (recv > 0) {
-    receive_buffer_size += recv;
-    ret = unpack_can_buffer(receive_buffer, receive_buffer_size, out_vec);
+    ret = unpack_can_buffer(recv, out_vec);
   }
   return ret;
 }
 
 void Panda::can_reset_communications() {
   handle->control_write(0xc0, 0, 0);
+  handle->can_read_reset();
 }
 
-bool Panda::unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_frame> &out_vec) {
-  int pos = 0;
+bool Panda::unpack_can_buffer(uint32_t size, std::vector<can_frame> &out_vec) {
+  // keep the ring contiguous for the frames that wrap around its end: bytes written past the end are
+  // copied to the start, and the first CAN_MAX_PACKET_SIZE bytes are mirrored past the end
+  const uint32_t start = rx_head % RECV_RING_SIZE;
+  if (start + size > RECV_RING_SIZE) {
+    memcpy(receive_buffer, &receive_buffer[RECV_RING_SIZE], start + size - RECV_RING_SIZE);
+  }
+  if (start < CAN_MAX_PACKET_SIZE) {
+    memcpy(&receive_buffer[RECV_RING_SIZE + start], &receive_buffer[start], std::min(size, CAN_MAX_PACKET_SIZE - start));
+  }
+  rx_head += size;
 
-  while (pos <= size - sizeof(can_header)) {
+  while (rx_head - rx_tail >= sizeof(can_header)) {
+    const uint8_t *data = &receive_buffer[rx_tail % RECV_RING_SIZE];
     can_header header;
-    memcpy(&header, &data[pos], sizeof(can_header));
+    memcpy(&header, data, sizeof(can_header));
 
     const uint8_t data_len = dlc_to_len[header.data_len_code];
-    if (pos + sizeof(can_header) + data_len > size) {
+    if (rx_tail + sizeof(can_header) + data_len > rx_head) {
       // we don't have all the data for this message yet
       break;
     }
 
-    if (calculate_checksum(&data[pos], sizeof(can_header) + data_len) != 0) {
+    if (calculate_checksum(data, sizeof(can_header) + data_len) != 0) {
       LOGE("Panda CAN checksum failed");
-      size = 0;
+      rx_tail = rx_head;
       can_reset_communications();
       return false;
     }
@@ -269,21 +316,30 @@ bool Panda::unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_fra
       canData.src += CAN_RETURNED_BUS_OFFSET;
     }
 
-    canData.dat.assign((char *)&data[pos + sizeof(can_header)], data_len);
+    canData.len = data_len;
+    memcpy(canData.dat, data + sizeof(can_header), data_len);
 
-    pos += sizeof(can_header) + data_len;
+    rx_tail += sizeof(can_header) + data_len;
   }
 
-  // move the overflowing data to the beginning of the buffer for the next round
-  memmove(data, &data[pos], size - pos);
-  size -= pos;
-
   return true;
 }
 
-uint8_t Panda::calculate_checksum(uint8_t *data, uint32_t len) {
-  uint8_t checksum = 0U;
-  for (uint32_t i = 0U; i < len; i++) {
+uint8_t Panda::calculate_checksum(const uint8_t *data, uint32_t len) {
+  // xor 8 bytes at a time, then fold the word down to one byte
+  uint64_t acc = 0;
+  uint32_t i = 0U;
+  for (; i + sizeof(acc) <= len; i += sizeof(acc)) {
+    uint64_t word;
+    memcpy(&word, &data[i], sizeof(word));
+    acc ^= word;
+  }
+  acc ^= acc >> 32;
+  acc ^= acc >> 16;
+  acc ^= acc >> 8;
+
+  uint8_t checksum = acc;
+  for (; i < len; i++) {
     checksum ^= data[i];
   }
   return checksum;
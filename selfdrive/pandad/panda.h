@@ -15,10 +15,11 @@
 #include "panda/board/can_definitions.h"
 #include "selfdrive/pandad/panda_comms.h"
 
-#define USB_TX_SOFT_LIMIT   (0x100U)
 #define USBPACKET_MAX_SIZE  (0x40)
 
 #define RECV_SIZE (0x4000U)
+#define RECV_RING_SIZE (2 * RECV_SIZE)
+#define CAN_MAX_PACKET_SIZE (uint32_t)(sizeof(can_header) + CAN_FRAME_MAX_LEN)
 
 #define CAN_REJECTED_BUS_OFFSET   0xC0U
 #define CAN_RETURNED_BUS_OFFSET 0x80U
@@ -36,17 +37,33 @@ struct __attribute__((packed)) can_header {
   uint8_t checksum : 8;
 };
 
+#define CAN_FRAME_MAX_LEN 64
+
+// fixed-size frame with an inline payload, so a vector of frames can be reused across receive cycles without allocating
 struct can_frame {
   long address;
-  std::string dat;
   long busTime;
   long src;
+  uint8_t len;
+  uint8_t dat[CAN_FRAME_MAX_LEN];
 };
 
+inline void can_frames_to_capnp(const std::vector<can_frame> &frames, capnp::List<cereal::CanData>::Builder can_list) {
+  for (uint i = 0; i < frames.size(); i++) {
+    const can_frame &f = frames[i];
+    auto c = can_list[i];
+    c.setAddress(f.address);
+    c.setBusTime(f.busTime);
+    c.setDat(kj::arrayPtr(f.dat, f.len));
+    c.setSrc(f.src);
+  }
+}
+
 
 class Panda {
 private:
   std::unique_ptr<PandaCommsHandle> handle;
+  void connect_hw(const std::string &serial);
 
 public:
   Panda(std::string serial="", uint32_t bus_offset=0);
@@ -70,6 +87,7 @@ public:
   void set_ir_pwr(uint16_t ir_pwr);
   std::optional<health_t> get_state();
   std::optional<can_health_t> get_can_state(uint16_t can_number);
+  std::optional<spi_stats_t> get_spi_stats();
   void set_loopback(bool loopback);
   std::optional<std::vector<uint8_t>> get_firmware_version();
   bool up_to_date();
@@ -81,17 +99,31 @@ public:
   void set_data_speed_kbps(uint16_t bus, uint16_t speed);
   void set_canfd_non_iso(uint16_t bus, bool non_iso);
   void can_send(capnp::List<cereal::CanData>::Reader can_data_list);
+  // frames already filtered to this panda's buses
+  void can_send(const std::vector<cereal::CanData::Reader> &can_data_list);
   bool can_receive(std::vector<can_frame>& out_vec);
   void can_reset_communications();
 
 protected:
   // for unit tests
-  uint8_t receive_buffer[RECV_SIZE + sizeof(can_header) + 64];
-  uint32_t receive_buffer_size = 0;
+  // Receive ring, indexed by the running byte counts rx_head (received) and rx_tail (parsed). The RECV_SIZE
+  // bytes after the ring let every read be written contiguously, partial frames are kept in place.
+  uint8_t receive_buffer[RECV_RING_SIZE + RECV_SIZE];
+  uint64_t rx_head = 0, rx_tail = 0;
+  uint8_t *rx_write_ptr() { return &receive_buffer[rx_head % RECV_RING_SIZE]; }
+
+  // frames are packed into transfers of up to tx_max_size bytes
+  uint32_t tx_max_size = USB_TX_MAX_SIZE;
+  std::vector<uint8_t> send_buffer;
 
   Panda(uint32_t bus_offset) : bus_offset(bus_offset) {}
   void pack_can_buffer(const capnp::List<cereal::CanData>::Reader &can_data_list,
                          std::function<void(uint8_t *, size_t)> write_func);
-  bool unpack_can_buffer(uint8_t *data, uint32_t &size, std::vector<can_frame> &out_vec);
-  uint8_t calculate_checksum(uint8_t *data, uint32_t len);
+  void pack_can_buffer(const std::vector<cereal::CanData::Reader> &can_data_list,
+                         std::function<void(uint8_t *, size_t)> write_func);
+  template <typename CanDataList>
+  void pack_frames(const CanDataList &can_data_list, const std::function<void(uint8_t *, size_t)> &write_func);
+  // parses the size bytes just written at rx_write_ptr()
+  bool unpack_can_buffer(uint32_t size, std::vector<can_frame> &out_vec);
+  uint8_t calculate_checksum(const uint8_t *data, uint32_t len);
 };
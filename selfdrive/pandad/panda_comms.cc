@@ -5,6 +5,7 @@
 #include <memory>
 
 #include "common/swaglog.h"
+#include "common/util.h"
 
 static libusb_context *init_usb_ctx() {
   libusb_context *context = nullptr;
@@ -83,6 +84,8 @@ PandaUsbHandle::~PandaUsbHandle() {
 }
 
 void PandaUsbHandle::cleanup() {
+  stop_rx_transfers();
+
   if (dev_handle) {
     libusb_release_interface(dev_handle, 0);
     libusb_close(dev_handle);
@@ -225,3 +228,112 @@ int PandaUsbHandle::bulk_read(unsigned char endpoint, unsigned char* data, int l
 
   return transferred;
 }
+
+bool PandaUsbHandle::start_rx_transfers() {
+  rx_started = true;
+  rx_ring = std::make_unique<SpscByteRing<USB_RX_RING_SIZE>>();
+  rx_buffers = std::make_unique<uint8_t[]>(USB_RX_TRANSFERS * USB_RX_TRANSFER_SIZE);
+
+  usb_event_thread = std::thread([this]() {
+    util::set_thread_name("pandad_usb_events");
+    timeval tv = {0, 100000};
+    while (!rx_exit || rx_in_flight > 0) {
+      libusb_handle_events_timeout_completed(ctx, &tv, NULL);
+    }
+  });
+
+  for (int i = 0; i < USB_RX_TRANSFERS; ++i) {
+    libusb_transfer *transfer = libusb_alloc_transfer(0);
+    if (transfer == NULL) break;
+
+    rx_transfers.push_back(transfer);
+    libusb_fill_bulk_transfer(transfer, dev_handle, 0x81, &rx_buffers[i * USB_RX_TRANSFER_SIZE], USB_RX_TRANSFER_SIZE,
+                              rx_transfer_cb, this, 0);
+    rx_in_flight++;
+    int err = libusb_submit_transfer(transfer);
+    if (err != 0) {
+      rx_in_flight--;
+      handle_usb_issue(err, __func__);
+      break;
+    }
+  }
+
+  if (rx_in_flight < USB_RX_TRANSFERS) {
+    LOGE("failed to start async usb transfers, falling back to synchronous reads");
+    stop_rx_transfers();
+    rx_ring.reset();
+    return false;
+  }
+  return true;
+}
+
+void PandaUsbHandle::stop_rx_transfers() {
+  if (!usb_event_thread.joinable()) return;
+
+  rx_exit = true;
+  for (auto transfer : rx_transfers) {
+    libusb_cancel_transfer(transfer);
+  }
+  // the event thread keeps running until all cancelled transfers are completed
+  usb_event_thread.join();
+
+  for (auto transfer : rx_transfers) {
+    libusb_free_transfer(transfer);
+  }
+  rx_transfers.clear();
+}
+
+void LIBUSB_CALL PandaUsbHandle::rx_transfer_cb(libusb_transfer *transfer) {
+  PandaUsbHandle *h = (PandaUsbHandle *)transfer->user_data;
+
+  switch (transfer->status) {
+    case LIBUSB_TRANSFER_COMPLETED:
+      // transfers are completed in submission order, so the stream stays in order
+      if (transfer->actual_length > 0 && !h->rx_ring->write(transfer->buffer, transfer->actual_length)) {
+        LOGE_100("usb rx ring full, dropped 0x%x bytes", transfer->actual_length);
+      }
+      break;
+    case LIBUSB_TRANSFER_TIMED_OUT:
+      break;
+    case LIBUSB_TRANSFER_OVERFLOW:
+      h->comms_healthy = false;
+      LOGE_100("overflow got 0x%x", transfer->actual_length);
+      break;
+    case LIBUSB_TRANSFER_NO_DEVICE:
+      LOGE("lost connection");
+      h->connected = false;
+      break;
+    case LIBUSB_TRANSFER_CANCELLED:
+      break;
+    default:
+      LOGE_100("usb transfer error %d in %s", transfer->status, __func__);
+      break;
+  }
+
+  if (!h->rx_exit && h->connected) {
+    int err = libusb_submit_transfer(transfer);
+    if (err == 0) return;
+    h->handle_usb_issue(err, __func__);
+  }
+  h->rx_in_flight--;
+}
+
+int PandaUsbHandle::can_read(unsigned char* data, int length) {
+  if (!connected) {
+    return 0;
+  }
+
+  if (!rx_started) {
+    start_rx_transfers();
+  }
+  if (!rx_ring) {
+    return bulk_read(0x81, data, length);
+  }
+  return rx_ring->read(data, length);
+}
+
+void PandaUsbHandle::can_read_reset() {
+  if (rx_ring) {
+    rx_ring->clear();
+  }
+}
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
+#include <cstring>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
 #ifndef __APPLE__
@@ -15,7 +20,66 @@
 
 #define TIMEOUT 0
 #define SPI_BUF_SIZE 2048
+#define SPI_XFER_SIZE (SPI_BUF_SIZE - 0x40)
 
+// largest CAN transmit transfer, about 3ms at USB full speed
+#define USB_TX_MAX_SIZE 0x1000U
+
+#define USB_RX_TRANSFERS 4
+#define USB_RX_TRANSFER_SIZE 0x4000U
+#define USB_RX_RING_SIZE (16 * USB_RX_TRANSFER_SIZE)
+
+// lock-free byte ring for one producer and one consumer thread
+template <size_t N>
+class SpscByteRing {
+  static_assert((N & (N - 1)) == 0, "size must be a power of two");
+
+public:
+  // all or nothing, returns false if there is not enough space
+  bool write(const uint8_t *data, size_t len) {
+    const size_t h = head.load(std::memory_order_relaxed);
+    if (N - (h - tail.load(std::memory_order_acquire)) < len) return false;
+
+    const size_t pos = h & (N - 1);
+    const size_t first = std::min(len, N - pos);
+    memcpy(&buf[pos], data, first);
+    memcpy(buf, data + first, len - first);
+    head.store(h + len, std::memory_order_release);
+    return true;
+  }
+
+  size_t read(uint8_t *data, size_t len) {
+    const size_t t = tail.load(std::memory_order_relaxed);
+    len = std::min(len, head.load(std::memory_order_acquire) - t);
+
+    const size_t pos = t & (N - 1);
+    const size_t first = std::min(len, N - pos);
+    memcpy(data, &buf[pos], first);
+    memcpy(data + first, buf, len - first);
+    tail.store(t + len, std::memory_order_release);
+    return len;
+  }
+
+  // drop everything written so far, consumer side only
+  void clear() { tail.store(head.load(std::memory_order_acquire), std::memory_order_release); }
+
+private:
+  std::atomic<size_t> head = 0, tail = 0;
+  uint8_t buf[N];
+};
+
+
+// host side SPI protocol counters, accumulated until they're taken
+struct spi_stats_t {
+  uint32_t transfers = 0;     // attempted spi_transfer calls
+  uint32_t retries = 0;       // failed attempts that were retried
+  uint32_t ioctls = 0;
+  uint32_t ack_waits = 0;
+  uint32_t ack_timeouts = 0;
+  uint32_t nacks = 0;
+  uint64_t ack_wait_ns = 0;
+  uint64_t ack_wait_max_ns = 0;
+};
 
 // comms base class
 class PandaCommsHandle {
@@ -34,6 +98,17 @@ public:
   virtual int control_read(uint8_t request, uint16_t param1, uint16_t param2, unsigned char *data, uint16_t length, unsigned int timeout=TIMEOUT) = 0;
   virtual int bulk_write(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout=TIMEOUT) = 0;
   virtual int bulk_read(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout=TIMEOUT) = 0;
+
+  // largest bulk write that goes out as a single transfer
+  virtual uint32_t max_bulk_write_size() { return USB_TX_MAX_SIZE; }
+
+  // CAN receive stream, returns the bytes read. The default is a synchronous bulk read.
+  virtual int can_read(unsigned char* data, int length) { return bulk_read(0x81, data, length); }
+  // drop any received data that hasn't been read yet, after the panda's CAN comms are reset
+  virtual void can_read_reset() {}
+
+  // SPI protocol counters since the last call, nullopt for other transports
+  virtual std::optional<spi_stats_t> take_spi_stats() { return std::nullopt; }
 };
 
 class PandaUsbHandle : public PandaCommsHandle {
@@ -44,6 +119,8 @@ public:
   int control_read(uint8_t request, uint16_t param1, uint16_t param2, unsigned char *data, uint16_t length, unsigned int timeout=TIMEOUT);
   int bulk_write(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout=TIMEOUT);
   int bulk_read(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout=TIMEOUT);
+  int can_read(unsigned char* data, int length);
+  void can_read_reset();
   void cleanup();
 
   static std::vector<std::string> list();
@@ -53,6 +130,64 @@ private:
   libusb_device_handle *dev_handle = NULL;
   std::recursive_mutex hw_lock;
   void handle_usb_issue(int err, const char func[]);
+
+  // asynchronous CAN receive: USB_RX_TRANSFERS bulk IN transfers are kept in flight,
+  // completed on usb_event_thread into rx_ring and read from there by can_read()
+  bool start_rx_transfers();
+  void stop_rx_transfers();
+  static void LIBUSB_CALL rx_transfer_cb(libusb_transfer *transfer);
+
+  bool rx_started = false;
+  std::atomic<bool> rx_exit = false;
+  std::atomic<int> rx_in_flight = 0;
+  std::vector<libusb_transfer *> rx_transfers;
+  std::unique_ptr<uint8_t[]> rx_buffers;
+  std::unique_ptr<SpscByteRing<USB_RX_RING_SIZE>> rx_ring;
+  std::thread usb_event_thread;
+};
+
+// Software stand-in for a panda, used for serials starting with "sim". It emulates the CAN packet
+// framing and the control endpoints used by pandad, generates synthetic CAN traffic and echoes
+// every sent frame back as a returned frame.
+class PandaSimHandle : public PandaCommsHandle {
+public:
+  PandaSimHandle(std::string serial);
+  ~PandaSimHandle();
+  int control_write(uint8_t request, uint16_t param1, uint16_t param2, unsigned int timeout=TIMEOUT);
+  int control_read(uint8_t request, uint16_t param1, uint16_t param2, unsigned char *data, uint16_t length, unsigned int timeout=TIMEOUT);
+  int bulk_write(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout=TIMEOUT);
+  int bulk_read(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout=TIMEOUT);
+  void cleanup();
+
+  static std::vector<std::string> list();
+
+private:
+  void generate_traffic(uint64_t now);
+  void push_frame(uint8_t bus, uint32_t addr, const uint8_t *dat, uint8_t len, bool returned);
+
+  std::mutex hw_lock;
+  std::vector<uint8_t> rx_stream;
+  size_t rx_pos = 0;
+  std::vector<uint8_t> fw_signature;
+
+  // synthetic traffic
+  double can_rate;
+  uint8_t can_len;
+  uint64_t start_time;
+  uint64_t generated = 0;
+
+  // state reported by the control endpoints
+  uint8_t ignition;
+  uint8_t safety_model = 0;
+  uint16_t safety_param = 0;
+  uint16_t alternative_experience = 0;
+  uint8_t power_save = 0;
+  uint8_t loopback = 0;
+  uint8_t heartbeat_engaged = 0;
+  uint16_t fan_speed = 0;
+  uint32_t rx_overflow = 0;
+  uint32_t tx_cnt[3] = {}, rx_cnt[3] = {};
+  uint16_t can_speed[3] = {5000, 5000, 5000}, data_speed[3] = {20000, 20000, 20000};
 };
 
 #ifndef __APPLE__
@@ -71,6 +206,8 @@ public:
   int control_read(uint8_t request, uint16_t param1, uint16_t param2, unsigned char *data, uint16_t length, unsigned int timeout=TIMEOUT);
   int bulk_write(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout=TIMEOUT);
   int bulk_read(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout=TIMEOUT);
+  uint32_t max_bulk_write_size() { return SPI_XFER_SIZE; }
+  std::optional<spi_stats_t> take_spi_stats();
   void cleanup();
 
   static std::vector<std::string> list();
@@ -89,5 +226,6 @@ private:
 
   spi_header header;
   uint32_t xfer_count = 0;
+  spi_stats_t stats;
 };
 #endif
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cstring>
+
+#include "common/swaglog.h"
+#include "common/timing.h"
+#include "common/util.h"
+#include "selfdrive/pandad/panda.h"
+
+// frames are dropped instead of generated when pandad falls this far behind
+#define SIM_MAX_BACKLOG 10000
+
+static uint8_t sim_checksum(const uint8_t *data, uint32_t len) {
+  uint8_t checksum = 0U;
+  for (uint32_t i = 0U; i < len; i++) {
+    checksum ^= data[i];
+  }
+  return checksum;
+}
+
+PandaSimHandle::PandaSimHandle(std::string serial) : PandaCommsHandle(serial) {
+  hw_serial = serial;
+  can_rate = util::getenv("PANDAD_SIM_CAN_RATE", 3000.0f);
+  ignition = util::getenv("PANDAD_SIM_IGNITION", 1);
+
+  // round the payload length up to the next valid CAN FD length
+  const int len = std::clamp(util::getenv("PANDAD_SIM_CAN_LEN", 8), 0, 64);
+  can_len = *std::lower_bound(std::begin(dlc_to_len), std::end(dlc_to_len), len);
+
+  // report the signature of the local firmware build, so the firmware check passes if it exists
+  for (auto fn : {"panda_h7.bin.signed", "panda.bin.signed"}) {
+    auto content = util::read_file(std::string("../../panda/board/obj/") + fn);
+    if (content.size() >= 128) {
+      fw_signature.assign(content.end() - 128, content.end());
+      break;
+    }
+  }
+
+  start_time = nanos_since_boot();
+  LOGW("simulated panda %s: %.0f frames/s, %d bytes", hw_serial.c_str(), can_rate, can_len);
+}
+
+PandaSimHandle::~PandaSimHandle() {
+  cleanup();
+  connected = false;
+}
+
+void PandaSimHandle::cleanup() {}
+
+std::vector<std::string> PandaSimHandle::list() {
+  std::vector<std::string> serials;
+  for (int i = 0; i < util::getenv("PANDAD_SIM", 0); ++i) {
+    serials.push_back("sim" + std::to_string(i));
+  }
+  return serials;
+}
+
+void PandaSimHandle::push_frame(uint8_t bus, uint32_t addr, const uint8_t *dat, uint8_t len, bool returned) {
+  can_header header = {};
+  header.addr = addr;
+  header.extended = addr >= 0x800 ? 1 : 0;
+  header.data_len_code = std::find(std::begin(dlc_to_len), std::end(dlc_to_len), len) - std::begin(dlc_to_len);
+  header.bus = bus;
+  header.returned = returned;
+
+  const size_t pos = rx_stream.size();
+  rx_stream.resize(pos + sizeof(can_header) + len);
+  memcpy(&rx_stream[pos], &header, sizeof(can_header));
+  memcpy(&rx_stream[pos + sizeof(can_header)], dat, len);
+  ((can_header *)&rx_stream[pos])->checksum = sim_checksum(&rx_stream[pos], sizeof(can_header) + len);
+}
+
+void PandaSimHandle::generate_traffic(uint64_t now) {
+  const uint64_t due = (now - start_time) * can_rate / 1e9;
+  if (due - generated > SIM_MAX_BACKLOG) {
+    rx_overflow += due - generated - SIM_MAX_BACKLOG;
+    generated = due - SIM_MAX_BACKLOG;
+  }
+
+  uint8_t dat[64] = {};
+  for (; generated < due; ++generated) {
+    // the first 8 bytes hold the time the frame appeared on the bus, to measure the publish latency
+    const uint64_t t = start_time + generated * 1e9 / can_rate;
+    memcpy(dat, &t, std::min<size_t>(sizeof(t), can_len));
+    if (can_len > sizeof(t)) {
+      dat[sizeof(t)] = generated & 0xff;
+    }
+
+    const uint8_t bus = generated % 3;
+    push_frame(bus, 0x100 + (generated / 3) % 32, dat, can_len, false);
+    rx_cnt[bus]++;
+  }
+}
+
+int PandaSimHandle::control_write(uint8_t request, uint16_t param1, uint16_t param2, unsigned int timeout) {
+  std::lock_guard lk(hw_lock);
+  switch (request) {
+    case 0xc0:  // reset communications
+      rx_stream.clear();
+      rx_pos = 0;
+      break;
+    case 0xdc:
+      safety_model = param1;
+      safety_param = param2;
+      break;
+    case 0xdf:
+      alternative_experience = param1;
+      break;
+    case 0xe7:
+      power_save = param1;
+      break;
+    case 0xe5:
+      loopback = param1;
+      break;
+    case 0xf3:
+      heartbeat_engaged = param1;
+      break;
+    case 0xb1:
+      fan_speed = param1;
+      break;
+    case 0xde:
+      if (param1 < 3) can_speed[param1] = param2;
+      break;
+    case 0xf9:
+      if (param1 < 3) data_speed[param1] = param2;
+      break;
+    default:
+      break;
+  }
+  return 0;
+}
+
+int PandaSimHandle::control_read(uint8_t request, uint16_t param1, uint16_t param2, unsigned char *data, uint16_t length, unsigned int timeout) {
+  std::lock_guard lk(hw_lock);
+  switch (request) {
+    case 0xc1: {
+      if (length < 1) return -1;
+      data[0] = (uint8_t)cereal::PandaState::PandaType::RED_PANDA;
+      return 1;
+    }
+    case 0xd2: {
+      health_t health = {};
+      health.uptime_pkt = (nanos_since_boot() - start_time) / 1e9;
+      health.voltage_pkt = 12000;
+      health.current_pkt = 100;
+      health.rx_buffer_overflow_pkt = rx_overflow;
+      health.ignition_line_pkt = ignition;
+      health.controls_allowed_pkt = heartbeat_engaged;
+      health.car_harness_status_pkt = 1;
+      health.safety_mode_pkt = safety_model;
+      health.safety_param_pkt = safety_param;
+      health.power_save_enabled_pkt = power_save;
+      health.alternative_experience_pkt = alternative_experience;
+      health.fan_power = fan_speed;
+      length = std::min<uint16_t>(length, sizeof(health));
+      memcpy(data, &health, length);
+      return length;
+    }
+    case 0xc2: {
+      can_health_t can_health = {};
+      if (param1 < 3) {
+        can_health.total_rx_cnt = rx_cnt[param1];
+        can_health.total_tx_cnt = tx_cnt[param1];
+        can_health.can_speed = can_speed[param1];
+        can_health.can_data_speed = data_speed[param1];
+        can_health.canfd_enabled = 1;
+        can_health.brs_enabled = 1;
+      }
+      length = std::min<uint16_t>(length, sizeof(can_health));
+      memcpy(data, &can_health, length);
+      return length;
+    }
+    case 0xb2: {
+      const uint16_t rpm = fan_speed * 65;
+      length = std::min<uint16_t>(length, sizeof(rpm));
+      memcpy(data, &rpm, length);
+      return length;
+    }
+    case 0xd0: {
+      length = std::min<uint16_t>(length, hw_serial.size());
+      memcpy(data, hw_serial.data(), length);
+      return length;
+    }
+    case 0xd3:
+    case 0xd4: {
+      if (fw_signature.empty()) return -1;
+      const size_t offset = request == 0xd3 ? 0 : 64;
+      length = std::min<uint16_t>(length, 64);
+      memcpy(data, &fw_signature[offset], length);
+      return length;
+    }
+    default:
+      memset(data, 0, length);
+      return length;
+  }
+}
+
+int PandaSimHandle::bulk_write(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout) {
+  if (endpoint != 3) {
+    return length;
+  }
+
+  std::lock_guard lk(hw_lock);
+  for (int pos = 0; pos + sizeof(can_header) <= length; ) {
+    can_header header;
+    memcpy(&header, &data[pos], sizeof(can_header));
+    const uint8_t data_len = dlc_to_len[header.data_len_code];
+    if (pos + sizeof(can_header) + data_len > length || sim_checksum(&data[pos], sizeof(can_header) + data_len) != 0) {
+      LOGE("simulated panda: invalid CAN packet in bulk write");
+      break;
+    }
+
+    // echo the frame back, like the panda does for every frame it sends
+    if (header.bus < 3) {
+      tx_cnt[header.bus]++;
+      push_frame(header.bus, header.addr, &data[pos + sizeof(can_header)], data_len, true);
+      if (loopback) {
+        rx_cnt[header.bus]++;
+        push_frame(header.bus, header.addr, &data[pos + sizeof(can_header)], data_len, false);
+      }
+    }
+    pos += sizeof(can_header) + data_len;
+  }
+  return length;
+}
+
+int PandaSimHandle::bulk_read(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout) {
+  if (endpoint != 0x81) {
+    return 0;
+  }
+
+  std::lock_guard lk(hw_lock);
+  generate_traffic(nanos_since_boot());
+
+  // the stream is cut at the read size, so frames can be split across reads like on the real panda
+  const int recv = std::min<size_t>(length, rx_stream.size() - rx_pos);
+  memcpy(data, rx_stream.data() + rx_pos, recv);
+  rx_pos += recv;
+  if (rx_pos == rx_stream.size() || rx_pos > rx_stream.size() / 2) {
+    rx_stream.erase(rx_stream.begin(), rx_stream.begin() + rx_pos);
+    rx_pos = 0;
+  }
+  return recv;
+}
@@ -7,13 +7,18 @@
 #include <cassert>
 #include <cerrno>
 #include <chrono>
+#include <condition_variable>
+#include <cstring>
 #include <future>
 #include <memory>
+#include <mutex>
 #include <thread>
 
 #include "cereal/gen/cpp/car.capnp.h"
 #include "cereal/messaging/messaging.h"
+#include "common/histogram.h"
 #include "common/params.h"
+#include "common/queue.h"
 #include "common/ratekeeper.h"
 #include "common/swaglog.h"
 #include "common/timing.h"
@@ -162,15 +167,84 @@ Panda *connect(std::string serial="", uint32_t index=0) {
   return panda.release();
 }
 
+// A sendcan message split by panda, panda i owns buses [i * PANDA_BUS_OFFSET, (i + 1) * PANDA_BUS_OFFSET).
+// The message is copied, so it can be shared with the send workers.
+struct SendcanMsg {
+  SendcanMsg(Message *msg, size_t num_pandas) : buf(kj::heapArray<capnp::word>(msg->getSize() / sizeof(capnp::word) + 1)),
+                                                frames(num_pandas) {
+    memcpy(buf.begin(), msg->getData(), msg->getSize());
+    reader = std::make_unique<capnp::FlatArrayMessageReader>(buf);
+    cereal::Event::Reader event = reader->getRoot<cereal::Event>();
+    log_mono_time = event.getLogMonoTime();
+    for (auto frame : event.getSendcan()) {
+      const uint32_t i = frame.getSrc() / PANDA_BUS_OFFSET;
+      if (i < frames.size()) {
+        frames[i].push_back(frame);
+      }
+    }
+  }
+
+  kj::Array<capnp::word> buf;
+  std::unique_ptr<capnp::FlatArrayMessageReader> reader;
+  uint64_t log_mono_time;
+  std::vector<std::vector<cereal::CanData::Reader>> frames;
+};
+
+static void panda_can_send(Panda *panda, const SendcanMsg &msg, size_t index) {
+  // Don't send if older than 1 second
+  if (nanos_since_boot() - msg.log_mono_time >= 1e9) {
+    LOGE("sendcan too old to send: %" PRIu64 ", %" PRIu64, nanos_since_boot(), msg.log_mono_time);
+    return;
+  }
+  LOGT("sending sendcan to panda: %s", (panda->hw_serial()).c_str());
+  panda->can_send(msg.frames[index]);
+  LOGT("sendcan sent to panda: %s", (panda->hw_serial()).c_str());
+}
+
+// Sends the sendcan frames of one panda on its own thread, so a slow transfer on one panda doesn't delay the others
+class PandaSendWorker {
+public:
+  PandaSendWorker(Panda *panda, size_t index) : panda(panda), index(index), thread(&PandaSendWorker::run, this) {}
+  ~PandaSendWorker() {
+    exit = true;
+    thread.join();
+  }
+  void push(const std::shared_ptr<SendcanMsg> &msg) {
+    if (!msg->frames[index].empty()) queue.push(msg);
+  }
+
+private:
+  void run() {
+    util::set_thread_name(("pandad_tx_" + std::to_string(index)).c_str());
+    std::shared_ptr<SendcanMsg> msg;
+    while (!exit) {
+      if (queue.try_pop(msg, 100)) {
+        panda_can_send(panda, *msg, index);
+      }
+    }
+  }
+
+  Panda *panda;
+  const size_t index;
+  std::atomic<bool> exit = false;
+  SafeQueue<std::shared_ptr<SendcanMsg>> queue;
+  std::thread thread;
+};
+
 void can_send_thread(std::vector<Panda *> pandas, bool fake_send) {
   util::set_thread_name("pandad_can_send");
 
-  AlignedBuffer aligned_buf;
   std::unique_ptr<Context> context(Context::create());
   std::unique_ptr<SubSocket> subscriber(SubSocket::create(context.get(), "sendcan"));
   assert(subscriber != NULL);
   subscriber->setTimeout(100);
 
+  // with several pandas, every panda gets its own send worker
+  std::vector<std::unique_ptr<PandaSendWorker>> workers;
+  for (int i = 0; i < pandas.size() && pandas.size() > 1; ++i) {
+    workers.push_back(std::make_unique<PandaSendWorker>(pandas[i], i));
+  }
+
   // run as fast as messages come in
   while (!do_exit && check_all_connected(pandas)) {
     std::unique_ptr<Message> msg(subscriber->receive());
@@ -180,56 +254,323 @@ void can_send_thread(std::vector<Panda *> pandas, bool fake_send) {
       }
       continue;
     }
+    if (fake_send) {
+      continue;
+    }
+
+    auto sendcan = std::make_shared<SendcanMsg>(msg.get(), pandas.size());
+    if (workers.empty()) {
+      panda_can_send(pandas[0], *sendcan, 0);
+    } else {
+      for (auto &w : workers) {
+        w->push(sendcan);
+      }
+    }
+  }
+}
 
-    capnp::FlatArrayMessageReader cmsg(aligned_buf.align(msg.get()));
-    cereal::Event::Reader event = cmsg.getRoot<cereal::Event>();
+// Reads one panda on its own thread, so a slow transfer on one panda doesn't delay the CAN of the others.
+// Every cycle the publisher requests a read from all workers and collects what they received in panda order.
+class PandaRecvWorker {
+public:
+  PandaRecvWorker(Panda *panda, size_t index) : panda(panda), index(index), thread(&PandaRecvWorker::run, this) {
+    frames.reserve(RECV_SIZE / sizeof(can_header));
+  }
+  ~PandaRecvWorker() {
+    {
+      std::lock_guard lk(lock);
+      exit = true;
+    }
+    cv.notify_all();
+    thread.join();
+  }
 
-    // Don't send if older than 1 second
-    if ((nanos_since_boot() - event.getLogMonoTime() < 1e9) && !fake_send) {
-      for (const auto& panda : pandas) {
-        LOGT("sending sendcan to panda: %s", (panda->hw_serial()).c_str());
-        panda->can_send(event.getSendcan());
-        LOGT("sendcan sent to panda: %s", (panda->hw_serial()).c_str());
+  void request() {
+    {
+      std::lock_guard lk(lock);
+      requested = true;
+    }
+    cv.notify_all();
+  }
+
+  // Waits until the requested read is done or the deadline passed, then moves the frames received so far
+  // to out. A read that misses the deadline is published in the next cycle. Returns false if a read failed.
+  bool collect(uint64_t deadline, std::vector<can_frame> &out, std::vector<std::pair<size_t, uint64_t>> &recv_times) {
+    std::unique_lock lk(lock);
+    cv.wait_for(lk, std::chrono::nanoseconds(std::max<int64_t>(0, deadline - nanos_since_boot())),
+                [this] { return !requested && !busy; });
+    for (const auto &[count, t] : frame_times) {
+      recv_times.emplace_back(count, t);
+    }
+    out.insert(out.end(), frames.begin(), frames.end());
+    frames.clear();
+    frame_times.clear();
+
+    const bool ret = healthy;
+    healthy = true;
+    return ret;
+  }
+
+private:
+  void run() {
+    util::set_thread_name(("pandad_rx_" + std::to_string(index)).c_str());
+    std::vector<can_frame> received;
+    received.reserve(RECV_SIZE / sizeof(can_header));
+
+    std::unique_lock lk(lock);
+    while (true) {
+      cv.wait(lk, [this] { return requested || exit; });
+      if (exit) break;
+
+      requested = false;
+      busy = true;
+      lk.unlock();
+      received.clear();
+      const bool ok = panda->can_receive(received);
+      const uint64_t t = nanos_since_boot();
+      lk.lock();
+
+      if (!received.empty()) {
+        frame_times.emplace_back(received.size(), t);
+        frames.insert(frames.end(), received.begin(), received.end());
       }
-    } else {
-      LOGE("sendcan too old to send: %" PRIu64 ", %" PRIu64, nanos_since_boot(), event.getLogMonoTime());
+      healthy &= ok;
+      busy = false;
+      cv.notify_all();
     }
   }
+
+  Panda *panda;
+  const size_t index;
+  std::mutex lock;
+  std::condition_variable cv;
+  bool requested = false, busy = false, exit = false;
+  bool healthy = true;
+  std::vector<can_frame> frames;
+  std::vector<std::pair<size_t, uint64_t>> frame_times;
+  std::thread thread;
+};
+
+static std::vector<float> latency_edges() {
+  std::vector<float> edges;
+  for (float ms = 0.25; ms <= 5; ms += 0.25) edges.push_back(ms);
+  for (float ms = 6; ms <= 20; ms += 1) edges.push_back(ms);
+  for (float ms = 25; ms <= 50; ms += 5) edges.push_back(ms);
+  for (float ms : {75, 100, 200, 500}) edges.push_back(ms);
+  return edges;
+}
+
+static std::vector<float> frame_count_edges() {
+  std::vector<float> edges;
+  for (int n = 1; n <= 1024; n *= 2) edges.push_back(n);
+  return edges;
 }
 
-void can_recv_thread(std::vector<Panda *> pandas) {
+// CAN receive telemetry: filled in by can_recv_thread, and sent as pandaCanStats once a second by
+// panda_state_thread, which also supplies the pandas' own frame counters
+class CanTelemetry {
+public:
+  CanTelemetry(size_t num_pandas) : buses(num_pandas * PANDA_CAN_CNT) {}
+
+  // frames of one publish, with the (frames, host time) of the reads that returned them
+  void add_publish(const std::vector<can_frame> &frames, const std::vector<std::pair<size_t, uint64_t>> &recv_times, uint64_t sent) {
+    std::lock_guard lk(lock);
+    publishes++;
+    frames_per_publish.add(frames.size());
+
+    size_t pos = 0;
+    for (const auto &[n, t] : recv_times) {
+      reads++;
+      frames_per_read.add(n);
+      latency.add((sent - t) / 1e6, n);
+
+      for (size_t end = std::min(pos + n, frames.size()); pos < end; ++pos) {
+        const long src = frames[pos].src;
+        const size_t idx = (src / PANDA_BUS_OFFSET) * PANDA_CAN_CNT + src % PANDA_BUS_OFFSET;
+        if (src >= 128 || src % PANDA_BUS_OFFSET >= PANDA_CAN_CNT || idx >= buses.size()) continue;
+
+        BusCounters &b = buses[idx];
+        b.frames++;
+        b.total_frames++;
+        if (b.last_seen > 0 && t > b.last_seen) {
+          b.max_gap = std::max(b.max_gap, t - b.last_seen);
+        }
+        b.last_seen = t;
+      }
+    }
+  }
+
+  // the panda's received and lost frame counters of one of its buses
+  void set_panda_counters(size_t panda_idx, size_t bus, uint32_t rx_cnt, uint32_t rx_lost_cnt) {
+    std::lock_guard lk(lock);
+    BusCounters &b = buses[panda_idx * PANDA_CAN_CNT + bus];
+    if (!b.panda_seen) {
+      // counters start at panda boot, only count from the first sample on
+      b.panda_rx_start = rx_cnt;
+      b.received_at_start = b.total_frames;
+      b.panda_seen = true;
+    } else {
+      b.panda_rx += rx_cnt - b.panda_rx_cnt;
+      b.panda_rx_lost += rx_lost_cnt - b.panda_rx_lost_cnt;
+    }
+    b.panda_rx_cnt = rx_cnt;
+    b.panda_rx_lost_cnt = rx_lost_cnt;
+  }
+
+  void send(PubMaster *pm) {
+    MessageBuilder msg;
+    auto evt = msg.initEvent();
+    auto stats = evt.initPandaCanStats();
+
+    std::lock_guard lk(lock);
+    const uint64_t now = nanos_since_boot();
+    const float interval = (now - last_send) / 1e9;
+    stats.setIntervalSeconds(interval);
+    stats.setReads(reads);
+    stats.setPublishes(publishes);
+    stats.setLatencyP50Ms(latency.percentile(0.5));
+    stats.setLatencyP90Ms(latency.percentile(0.9));
+    stats.setLatencyP99Ms(latency.percentile(0.99));
+    stats.setLatencyMaxMs(latency.max_value);
+    latency.to_capnp(stats.initLatencyHistogram());
+    frames_per_read.to_capnp(stats.initFramesPerRead());
+    frames_per_publish.to_capnp(stats.initFramesPerPublish());
+
+    auto bs = stats.initBuses(buses.size());
+    for (int i = 0; i < buses.size(); ++i) {
+      BusCounters &b = buses[i];
+      bs[i].setBus((i / PANDA_CAN_CNT) * PANDA_BUS_OFFSET + i % PANDA_CAN_CNT);
+      bs[i].setFrames(b.frames);
+      bs[i].setFramesPerSecond(interval > 0 ? b.frames / interval : 0);
+      bs[i].setMaxGapMs(b.max_gap / 1e6);
+      bs[i].setPandaRxFrames(b.panda_rx);
+      bs[i].setPandaRxLost(b.panda_rx_lost);
+      if (b.panda_seen) {
+        const int64_t panda_total = (uint32_t)(b.panda_rx_cnt - b.panda_rx_start);
+        bs[i].setRxCntDeficit(panda_total - (int64_t)(b.total_frames - b.received_at_start));
+      }
+      b.frames = b.panda_rx = b.panda_rx_lost = 0;
+      b.max_gap = 0;
+    }
+
+    reads = publishes = 0;
+    latency.clear();
+    frames_per_read.clear();
+    frames_per_publish.clear();
+    last_send = now;
+
+    pm->send("pandaCanStats", msg);
+  }
+
+private:
+  struct BusCounters {
+    uint32_t frames = 0;
+    uint64_t total_frames = 0;
+    uint64_t last_seen = 0, max_gap = 0;
+    bool panda_seen = false;
+    uint32_t panda_rx_cnt = 0, panda_rx_lost_cnt = 0, panda_rx_start = 0;
+    uint64_t received_at_start = 0;
+    uint32_t panda_rx = 0, panda_rx_lost = 0;
+  };
+
+  std::mutex lock;
+  std::vector<BusCounters> buses;
+  uint32_t reads = 0, publishes = 0;
+  TelemetryHistogram latency{latency_edges()};
+  TelemetryHistogram frames_per_read{frame_count_edges()};
+  TelemetryHistogram frames_per_publish{frame_count_edges()};
+  uint64_t last_send = nanos_since_boot();
+};
+
+void can_recv_thread(std::vector<Panda *> pandas, CanTelemetry *telemetry) {
   util::set_thread_name("pandad_can_recv");
 
   PubMaster pm({"can"});
 
-  // run at 100Hz
+  // By default frames are published at a fixed 100Hz. With PANDAD_CAN_BATCH set, the pandas are polled
+  // every millisecond and frames are published as soon as that many have arrived or the oldest one is
+  // PANDAD_CAN_LATENCY_MS old, but at most PANDAD_CAN_MAX_RATE times a second.
+  const int batch_size = util::getenv("PANDAD_CAN_BATCH", 0);
+  const bool event_driven = batch_size > 0;
+  const uint64_t latency_budget = util::getenv("PANDAD_CAN_LATENCY_MS", 10.0f) * 1e6;
+  const uint64_t min_publish_interval = 1e9 / util::getenv("PANDAD_CAN_MAX_RATE", 500.0f);
+  if (event_driven) {
+    LOGW("event driven can receive: batch %d frames, latency budget %.1fms, max %.0fHz",
+         batch_size, latency_budget / 1e6, 1e9 / min_publish_interval);
+  }
+
   RateKeeper rk("pandad_can_recv", 100);
+  // RateKeeper sleeps in whole milliseconds, which is no sleep at all at 1kHz, so the
+  // event driven loop keeps its own deadline
+  const uint64_t poll_interval = 1e6;
+  uint64_t next_poll = nanos_since_boot() + poll_interval;
+  // reused every cycle, each panda can return at most RECV_SIZE / sizeof(can_header) frames per read
   std::vector<can_frame> raw_can_data;
+  raw_can_data.reserve(pandas.size() * RECV_SIZE / sizeof(can_header));
+  // (frames, time) of every read that returned frames since the last publish
+  std::vector<std::pair<size_t, uint64_t>> recv_times;
+  bool comms_healthy = true;
+  uint64_t last_publish = nanos_since_boot();
+
+  // with several pandas, every panda is read in parallel by its own worker, waiting at most half a cycle
+  std::vector<std::unique_ptr<PandaRecvWorker>> workers;
+  for (int i = 0; i < pandas.size() && pandas.size() > 1; ++i) {
+    workers.push_back(std::make_unique<PandaRecvWorker>(pandas[i], i));
+  }
+  const uint64_t read_budget = (event_driven ? 1e6 : 10e6) / 2;
 
   while (!do_exit && check_all_connected(pandas)) {
-    bool comms_healthy = true;
-    raw_can_data.clear();
-    for (const auto& panda : pandas) {
-      comms_healthy &= panda->can_receive(raw_can_data);
+    if (workers.empty()) {
+      const size_t received = raw_can_data.size();
+      comms_healthy &= pandas[0]->can_receive(raw_can_data);
+      if (raw_can_data.size() > received) {
+        recv_times.emplace_back(raw_can_data.size() - received, nanos_since_boot());
+      }
+    } else {
+      for (auto &w : workers) {
+        w->request();
+      }
+      // frames are merged in panda order
+      const uint64_t deadline = nanos_since_boot() + read_budget;
+      for (auto &w : workers) {
+        comms_healthy &= w->collect(deadline, raw_can_data, recv_times);
+      }
     }
 
-    MessageBuilder msg;
-    auto evt = msg.initEvent();
-    evt.setValid(comms_healthy);
-    auto canData = evt.initCan(raw_can_data.size());
-    for (uint i = 0; i<raw_can_data.size(); i++) {
-      canData[i].setAddress(raw_can_data[i].address);
-      canData[i].setBusTime(raw_can_data[i].busTime);
-      canData[i].setDat(kj::arrayPtr((uint8_t*)raw_can_data[i].dat.data(), raw_can_data[i].dat.size()));
-      canData[i].setSrc(raw_can_data[i].src);
+    const uint64_t now = nanos_since_boot();
+    const uint64_t oldest = recv_times.empty() ? last_publish : recv_times[0].second;
+    const bool publish = !event_driven || (now - last_publish >= min_publish_interval &&
+                                           (raw_can_data.size() >= (size_t)batch_size || now - oldest >= latency_budget));
+    if (publish) {
+      MessageBuilder msg;
+      auto evt = msg.initEvent();
+      evt.setValid(comms_healthy);
+      can_frames_to_capnp(raw_can_data, evt.initCan(raw_can_data.size()));
+      pm.send("can", msg);
+
+      telemetry->add_publish(raw_can_data, recv_times, nanos_since_boot());
+
+      raw_can_data.clear();
+      recv_times.clear();
+      comms_healthy = true;
+      last_publish = now;
     }
-    pm.send("can", msg);
 
-    rk.keepTime();
+    if (event_driven) {
+      const uint64_t t = nanos_since_boot();
+      if (t < next_poll) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(next_poll - t));
+        next_poll += poll_interval;
+      } else {
+        next_poll = t + poll_interval;
+      }
+    } else {
+      rk.keepTime();
+    }
   }
 }
 
-std::optional<bool> send_panda_states(PubMaster *pm, const std::vector<Panda *> &pandas, bool spoofing_started) {
+std::optional<bool> send_panda_states(PubMaster *pm, const std::vector<Panda *> &pandas, bool spoofing_started, CanTelemetry *telemetry) {
   bool ignition_local = false;
   const uint32_t pandas_cnt = pandas.size();
 
@@ -332,6 +673,18 @@ std::optional<bool> send_panda_states(PubMaster *pm, const std::vector<Panda *>
     ps.setSbu1Voltage(health.sbu1_voltage_mV / 1000.0f);
     ps.setSbu2Voltage(health.sbu2_voltage_mV / 1000.0f);
 
+    if (auto spi = panda->get_spi_stats()) {
+      auto ss = ps.initSpiStats();
+      const float transfers = std::max(spi->transfers, 1U);
+      ss.setTransfers(spi->transfers);
+      ss.setIoctlsPerTransfer(spi->ioctls / transfers);
+      ss.setRetryRate(spi->retries / transfers);
+      ss.setAckWaitMeanUs(spi->ack_waits > 0 ? spi->ack_wait_ns / 1e3 / spi->ack_waits : 0.0f);
+      ss.setAckWaitMaxUs(spi->ack_wait_max_ns / 1e3);
+      ss.setAckTimeouts(spi->ack_timeouts);
+      ss.setNacks(spi->nacks);
+    }
+
     std::array<cereal::PandaState::PandaCanState::Builder, PANDA_CAN_CNT> cs = {ps.initCanState0(), ps.initCanState1(), ps.initCanState2()};
 
     for (uint32_t j = 0; j < PANDA_CAN_CNT; j++) {
@@ -351,6 +704,7 @@ std::optional<bool> send_panda_states(PubMaster *pm, const std::vector<Panda *>
       cs[j].setTotalRxLostCnt(can_health.total_rx_lost_cnt);
       cs[j].setTotalTxCnt(can_health.total_tx_cnt);
       cs[j].setTotalRxCnt(can_health.total_rx_cnt);
+      telemetry->set_panda_counters(i, j, can_health.total_rx_cnt, can_health.total_rx_lost_cnt);
       cs[j].setTotalFwdCnt(can_health.total_fwd_cnt);
       cs[j].setCanSpeed(can_health.can_speed);
       cs[j].setCanDataSpeed(can_health.can_data_speed);
@@ -404,12 +758,12 @@ void send_peripheral_state(PubMaster *pm, Panda *panda) {
   pm->send("peripheralState", msg);
 }
 
-void panda_state_thread(std::vector<Panda *> pandas, bool spoofing_started) {
+void panda_state_thread(std::vector<Panda *> pandas, bool spoofing_started, CanTelemetry *telemetry) {
   util::set_thread_name("pandad_panda_state");
 
   Params params;
   SubMaster sm({"controlsState"});
-  PubMaster pm({"pandaStates", "peripheralState"});
+  PubMaster pm({"pandaStates", "peripheralState", "pandaCanStats"});
 
   Panda *peripheral_panda = pandas[0];
   bool is_onroad = false;
@@ -432,7 +786,12 @@ void panda_state_thread(std::vector<Panda *> pandas, bool spoofing_started) {
       send_peripheral_state(&pm, peripheral_panda);
     }
 
-    auto ignition_opt = send_panda_states(&pm, pandas, spoofing_started);
+    auto ignition_opt = send_panda_states(&pm, pandas, spoofing_started, telemetry);
+
+    // send out pandaCanStats at 1Hz
+    if (sm.frame % 10 == 0) {
+      telemetry->send(&pm);
+    }
 
     if (!ignition_opt) {
       LOGE("Failed to get ignition_opt");
@@ -582,12 +941,13 @@ void pandad_main_thread(std::vector<std::string> serials) {
     LOGW("connected to all pandas");
 
     std::vector<std::thread> threads;
+    CanTelemetry can_telemetry(pandas.size());
 
-    threads.emplace_back(panda_state_thread, pandas, getenv("STARTED") != nullptr);
+    threads.emplace_back(panda_state_thread, pandas, getenv("STARTED") != nullptr, &can_telemetry);
     threads.emplace_back(peripheral_control_thread, pandas[0], getenv("NO_FAN_CONTROL") != nullptr);
 
     threads.emplace_back(can_send_thread, pandas, getenv("FAKESEND") != nullptr);
-    threads.emplace_back(can_recv_thread, pandas);
+    threads.emplace_back(can_recv_thread, pandas, &can_telemetry);
 
     for (auto &t : threads) t.join();
   }
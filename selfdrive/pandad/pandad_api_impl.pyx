@@ -1,15 +1,19 @@
 # distutils: language = c++
 # cython: language_level=3
+from libc.stdint cimport uint8_t
+from libc.string cimport memcpy
 from libcpp.vector cimport vector
 from libcpp.string cimport string
 from libcpp cimport bool
 
 cdef extern from "panda.h":
+  cdef int CAN_FRAME_MAX_LEN
   cdef struct can_frame:
     long address
-    string dat
     long busTime
     long src
+    uint8_t len
+    uint8_t dat[64]
 
 cdef extern from "can_list_to_can_capnp.cc":
   void can_list_to_can_capnp_cpp(const vector[can_frame] &can_list, string &out, bool sendCan, bool valid)
@@ -17,13 +21,19 @@ cdef extern from "can_list_to_can_capnp.cc":
 def can_list_to_can_capnp(can_msgs, msgtype='can', valid=True):
   cdef can_frame *f
   cdef vector[can_frame] can_list
+  cdef const unsigned char[:] dat
 
   can_list.reserve(len(can_msgs))
   for can_msg in can_msgs:
     f = &(can_list.emplace_back())
     f.address = can_msg[0]
     f.busTime = can_msg[1]
-    f.dat = can_msg[2]
+    dat = can_msg[2]
+    if dat.shape[0] > CAN_FRAME_MAX_LEN:
+      raise ValueError(f"CAN payload too long: {dat.shape[0]} bytes")
+    f.len = dat.shape[0]
+    if f.len > 0:
+      memcpy(f.dat, &dat[0], f.len)
     f.src = can_msg[3]
 
   cdef string out
@@ -29,6 +29,12 @@ enum SpiError {
 };
 
 const unsigned int SPI_ACK_TIMEOUT = 500; // milliseconds
+
+// ACK polling: a few back-to-back polls, then exponential backoff between them
+const int SPI_ACK_SPIN_POLLS = 4;
+const unsigned int SPI_ACK_BACKOFF_MIN_US = 8;
+const unsigned int SPI_ACK_BACKOFF_MAX_US = 256;
+
 const std::string SPI_DEVICE = "/dev/spidev0.0";
 
 class LockEx {
@@ -154,6 +160,13 @@ int PandaSpiHandle::control_read(uint8_t request, uint16_t param1, uint16_t para
   return spi_transfer_retry(0, (uint8_t *) &packet, sizeof(packet), data, length, timeout);
 }
 
+std::optional<spi_stats_t> PandaSpiHandle::take_spi_stats() {
+  std::lock_guard lk(hw_lock);
+  spi_stats_t ret = stats;
+  stats = {};
+  return ret;
+}
+
 int PandaSpiHandle::bulk_write(unsigned char endpoint, unsigned char* data, int length, unsigned int timeout) {
   return bulk_transfer(endpoint, data, length, NULL, 0, timeout);
 }
@@ -162,7 +175,7 @@ int PandaSpiHandle::bulk_read(unsigned char endpoint, unsigned char* data, int l
 }
 
 int PandaSpiHandle::bulk_transfer(uint8_t endpoint, uint8_t *tx_data, uint16_t tx_len, uint8_t *rx_data, uint16_t rx_len, unsigned int timeout) {
-  const int xfer_size = SPI_BUF_SIZE - 0x40;
+  const int xfer_size = SPI_XFER_SIZE;
 
   int ret = 0;
   uint16_t length = (tx_data != NULL) ? tx_len : rx_len;
@@ -230,6 +243,10 @@ int PandaSpiHandle::spi_transfer_retry(uint8_t endpoint, uint8_t *tx_data, uint1
     if (ret < 0) {
       timed_out = (timeout != 0) && (timeout_count > 5);
       timeout_count += ret == SpiError::ACK_TIMEOUT;
+      {
+        std::lock_guard lk(hw_lock);
+        stats.retries += connected && !timed_out;
+      }
 
       // give other threads a chance to run
       std::this_thread::yield();
@@ -254,6 +271,10 @@ int PandaSpiHandle::spi_transfer_retry(uint8_t endpoint, uint8_t *tx_data, uint1
 }
 
 int PandaSpiHandle::wait_for_ack(uint8_t ack, uint8_t tx, unsigned int timeout, unsigned int length) {
+  // PANDAD_SPI_ACK_BACKOFF=0 polls back-to-back until the ACK shows up
+  static const bool ack_backoff = util::getenv("PANDAD_SPI_ACK_BACKOFF", 1) != 0;
+
+  const uint64_t start_nanos = nanos_since_boot();
   double start_millis = millis_since_boot();
   if (timeout == 0) {
     timeout = SPI_ACK_TIMEOUT;
@@ -267,28 +288,45 @@ int PandaSpiHandle::wait_for_ack(uint8_t ack, uint8_t tx, unsigned int timeout,
   };
   memset(tx_buf, tx, length);
 
+  int ret = 0;
+  int polls = 0;
+  unsigned int backoff_us = SPI_ACK_BACKOFF_MIN_US;
   while (true) {
-    int ret = lltransfer(transfer);
+    ret = lltransfer(transfer);
     if (ret < 0) {
       SPILOG(LOGE, "SPI: failed to send ACK request");
-      return ret;
+      break;
     }
 
     if (rx_buf[0] == ack) {
+      ret = 0;
       break;
     } else if (rx_buf[0] == SPI_NACK) {
       SPILOG(LOGD, "SPI: got NACK, waiting for 0x%x", ack);
-      return SpiError::NACK;
+      ret = SpiError::NACK;
+      stats.nacks++;
+      break;
     }
 
     // handle timeout
     if (millis_since_boot() - start_millis > timeout) {
       SPILOG(LOGW, "SPI: timed out waiting for ACK, waiting for 0x%x", ack);
-      return SpiError::ACK_TIMEOUT;
+      ret = SpiError::ACK_TIMEOUT;
+      stats.ack_timeouts++;
+      break;
+    }
+
+    if (ack_backoff && ++polls > SPI_ACK_SPIN_POLLS) {
+      usleep(backoff_us);
+      backoff_us = std::min(backoff_us * 2, SPI_ACK_BACKOFF_MAX_US);
     }
   }
 
-  return 0;
+  const uint64_t wait_ns = nanos_since_boot() - start_nanos;
+  stats.ack_waits++;
+  stats.ack_wait_ns += wait_ns;
+  stats.ack_wait_max_ns = std::max(stats.ack_wait_max_ns, wait_ns);
+  return ret;
 }
 
 int PandaSpiHandle::lltransfer(spi_ioc_transfer &t) {
@@ -310,6 +348,7 @@ int PandaSpiHandle::lltransfer(spi_ioc_transfer &t) {
   }
 
   int ret = util::safe_ioctl(spi_fd, SPI_IOC_MESSAGE(1), &t);
+  stats.ioctls++;
 
   if (err_prob > 0) {
     if ((static_cast<double>(rand()) / RAND_MAX) < err_prob && t.rx_buf != (uint64_t)NULL) {
@@ -335,6 +374,7 @@ int PandaSpiHandle::spi_transfer(uint8_t endpoint, uint8_t *tx_data, uint16_t tx
   assert(max_rx_len < SPI_BUF_SIZE);
 
   xfer_count++;
+  stats.transfers++;
   header = {
     .sync = SPI_SYNC,
     .endpoint = endpoint,
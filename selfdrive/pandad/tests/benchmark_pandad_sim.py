@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Measure pandad throughput, CPU usage and publish latency against simulated pandas, no hardware needed.
+
+  selfdrive/pandad/tests/benchmark_pandad_sim.py --rate 10000 --len 64 --pandas 2
+
+The simulated pandas stamp every generated frame with the time it appeared on the bus, the latency is
+the difference to the logMonoTime of the can message it was published in.
+"""
+import argparse
+import os
+import subprocess
+import time
+
+import numpy as np
+import psutil
+
+import cereal.messaging as messaging
+from openpilot.common.basedir import BASEDIR
+from openpilot.selfdrive.car import make_can_msg
+from openpilot.selfdrive.pandad import can_list_to_can_capnp
+
+SIM_BUSES = (0, 1, 2)
+
+
+def run(args) -> dict:
+  env = os.environ.copy()
+  env.update({
+    "PANDAD_SIM": str(args.pandas),
+    "PANDAD_SIM_CAN_RATE": str(args.rate),
+    "PANDAD_SIM_CAN_LEN": str(args.len),
+    "BOARDD_SKIP_FW_CHECK": "1",
+    "STARTED": "1",
+  })
+  if args.batch > 0:
+    env["PANDAD_CAN_BATCH"] = str(args.batch)
+
+  can_sock = messaging.sub_sock('can', conflate=False, timeout=100)
+  sendcan = messaging.pub_sock('sendcan')
+  proc = subprocess.Popen(["./pandad"], cwd=os.path.join(BASEDIR, "selfdrive/pandad"), env=env)
+  try:
+    # wait for the first message, then measure
+    while len(messaging.drain_sock_raw(can_sock, wait_for_one=True)) == 0:
+      assert proc.poll() is None, "pandad exited"
+
+    p = psutil.Process(proc.pid)
+    p.cpu_percent()
+    latencies, publishes, rx_frames, echoed, sent = [], 0, 0, 0, 0
+    st = time.monotonic()
+    next_send = st
+    while time.monotonic() - st < args.duration:
+      if args.sendcan > 0 and time.monotonic() >= next_send:
+        msgs = [make_can_msg(0x200 + i, b"\x00" * 8, SIM_BUSES[i % 3] + 4 * (i % args.pandas)) for i in range(args.sendcan)]
+        sendcan.send(can_list_to_can_capnp(msgs, msgtype='sendcan'))
+        sent += len(msgs)
+        next_send += 0.01
+
+      for msg in messaging.drain_sock(can_sock):
+        publishes += 1
+        for c in msg.can:
+          if c.src >= 128:
+            echoed += 1
+          elif len(c.dat) >= 8 and c.address < 0x200:
+            rx_frames += 1
+            latencies.append(msg.logMonoTime - int.from_bytes(c.dat[:8], 'little'))
+    cpu = p.cpu_percent()
+    dt = time.monotonic() - st
+  finally:
+    proc.terminate()
+    proc.wait()
+
+  lat = np.array(latencies) / 1e6 if len(latencies) else np.zeros(1)
+  return {
+    "frames/s": rx_frames / dt,
+    "publishes/s": publishes / dt,
+    "echoed/sent": f"{echoed}/{sent}",
+    "cpu %": cpu,
+    "latency p50 ms": np.percentile(lat, 50),
+    "latency p99 ms": np.percentile(lat, 99),
+    "latency max ms": lat.max(),
+  }
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("--pandas", type=int, default=1)
+  parser.add_argument("--rate", type=float, default=3000, help="frames/s generated by every panda")
+  parser.add_argument("--len", type=int, default=8, help="payload length, at least 8 to measure latency")
+  parser.add_argument("--batch", type=int, default=0, help="PANDAD_CAN_BATCH, 0 for the fixed 100Hz loop")
+  parser.add_argument("--sendcan", type=int, default=10, help="frames sent every 10ms")
+  parser.add_argument("--duration", type=float, default=10)
+  args = parser.parse_args()
+
+  for k, v in run(args).items():
+    print(f"{k:>16}: {v:.2f}" if isinstance(v, float) else f"{k:>16}: {v}")
@@ -29,7 +29,7 @@ class TestBoarddSpi:
     setup_pandad(1)
 
     sendcan = messaging.pub_sock('sendcan')
-    socks = {s: messaging.sub_sock(s, conflate=False, timeout=100) for s in ('can', 'pandaStates', 'peripheralState')}
+    socks = {s: messaging.sub_sock(s, conflate=False, timeout=100) for s in ('can', 'pandaStates', 'peripheralState', 'pandaCanStats')}
     time.sleep(2)
     for s in socks.values():
       messaging.drain_sock_raw(s)
@@ -86,6 +86,10 @@ class TestBoarddSpi:
             assert 4000 < ps.voltage < 14000
             assert 100 < ps.current < 1000
             assert ps.fanSpeedRpm < 8000
+          elif service == "pandaCanStats":
+            cs = m.pandaCanStats
+            assert [b.bus for b in cs.buses] == [0, 1, 2]
+            assert len(cs.latencyHistogram.counts) == len(cs.latencyHistogram.upperEdges) + 1
 
       time.sleep(0.5)
     et = time.monotonic() - st
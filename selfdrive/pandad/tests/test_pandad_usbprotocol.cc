@@ -9,8 +9,9 @@
 struct PandaTest : public Panda {
   PandaTest(uint32_t bus_offset, int can_list_size, cereal::PandaState::PandaType hw_type);
   void test_can_send();
-  void test_can_recv(uint32_t chunk_size = 0);
+  void test_can_recv(uint32_t chunk_size = 0, uint64_t ring_offset = 0);
   void test_chunked_can_recv();
+  void benchmark_can_recv();
 
   std::map<int, std::string> test_data;
   int can_list_size = 0;
@@ -51,10 +52,15 @@ PandaTest::PandaTest(uint32_t bus_offset_, int can_list_size, cereal::PandaState
 
 void PandaTest::test_can_send() {
   std::vector<uint8_t> unpacked_data;
+  int transfers = 0;
   this->pack_can_buffer(can_data_list, [&](uint8_t *chunk, size_t size) {
+    REQUIRE(size <= this->tx_max_size);
     unpacked_data.insert(unpacked_data.end(), chunk, &chunk[size]);
+    ++transfers;
   });
   REQUIRE(unpacked_data.size() == total_pakets_size);
+  // frames are only split into a new transfer when the next one doesn't fit
+  REQUIRE(transfers <= 1 + total_pakets_size / (this->tx_max_size - CAN_MAX_PACKET_SIZE + 1));
 
   int cnt = 0;
   INFO("test can message integrity");
@@ -73,22 +79,22 @@ void PandaTest::test_can_send() {
   REQUIRE(cnt == can_list_size);
 }
 
-void PandaTest::test_can_recv(uint32_t rx_chunk_size) {
+void PandaTest::test_can_recv(uint32_t rx_chunk_size, uint64_t ring_offset) {
   std::vector<can_frame> frames;
   this->pack_can_buffer(can_data_list, [&](uint8_t *data, uint32_t size) {
     if (rx_chunk_size == 0) {
-      REQUIRE(this->unpack_can_buffer(data, size, frames));
+      memcpy(this->rx_write_ptr(), data, size);
+      REQUIRE(this->unpack_can_buffer(size, frames));
     } else {
-      this->receive_buffer_size = 0;
+      this->rx_head = this->rx_tail = ring_offset;
       uint32_t pos = 0;
 
       while (pos < size) {
         uint32_t chunk_size = std::min(rx_chunk_size, size - pos);
-        memcpy(&this->receive_buffer[this->receive_buffer_size], &data[pos], chunk_size);
-        this->receive_buffer_size += chunk_size;
+        memcpy(this->rx_write_ptr(), &data[pos], chunk_size);
         pos += chunk_size;
 
-        REQUIRE(this->unpack_can_buffer(this->receive_buffer, this->receive_buffer_size, frames));
+        REQUIRE(this->unpack_can_buffer(chunk_size, frames));
       }
     }
   });
@@ -96,12 +102,34 @@ void PandaTest::test_can_recv(uint32_t rx_chunk_size) {
   REQUIRE(frames.size() == can_list_size);
   for (int i = 0; i < frames.size(); ++i) {
     REQUIRE(frames[i].address == i);
-    REQUIRE(test_data.find(frames[i].dat.size()) != test_data.end());
-    const std::string &dat = test_data[frames[i].dat.size()];
-    REQUIRE(memcmp(dat.data(), frames[i].dat.data(), dat.size()) == 0);
+    REQUIRE(test_data.find(frames[i].len) != test_data.end());
+    const std::string &dat = test_data[frames[i].len];
+    REQUIRE(memcmp(dat.data(), frames[i].dat, dat.size()) == 0);
   }
 }
 
+void PandaTest::benchmark_can_recv() {
+  std::vector<uint8_t> packed;
+  this->pack_can_buffer(can_data_list, [&](uint8_t *chunk, size_t size) {
+    packed.insert(packed.end(), chunk, &chunk[size]);
+  });
+
+  std::vector<can_frame> frames;
+  BENCHMARK("unpack + serialize " + std::to_string(can_list_size) + " frames") {
+    frames.clear();
+    for (uint32_t pos = 0; pos < packed.size(); pos += RECV_SIZE) {
+      const uint32_t size = std::min<uint32_t>(RECV_SIZE, packed.size() - pos);
+      memcpy(this->rx_write_ptr(), &packed[pos], size);
+      this->unpack_can_buffer(size, frames);
+    }
+
+    MessageBuilder msg;
+    can_frames_to_capnp(frames, msg.initEvent().initCan(frames.size()));
+    return msg.getSerializedSize();
+  };
+  REQUIRE(frames.size() == can_list_size);
+}
+
 TEST_CASE("send/recv CAN 2.0 packets") {
   auto bus_offset = GENERATE(0, 4);
   auto can_list_size = GENERATE(1, 3, 5, 10, 30, 60, 100, 200);
@@ -116,6 +144,9 @@ TEST_CASE("send/recv CAN 2.0 packets") {
   SECTION("chunked_can_receive") {
     test.test_can_recv(0x40);
   }
+  SECTION("chunked_can_receive_ring_wrap") {
+    test.test_can_recv(0x40, RECV_RING_SIZE - 3);
+  }
 }
 
 TEST_CASE("send/recv CAN FD packets") {
@@ -126,10 +157,23 @@ TEST_CASE("send/recv CAN FD packets") {
   SECTION("can_send") {
     test.test_can_send();
   }
+  SECTION("can_send_spi") {
+    test.tx_max_size = SPI_XFER_SIZE;
+    test.test_can_send();
+  }
   SECTION("can_receive") {
     test.test_can_recv();
   }
   SECTION("chunked_can_receive") {
     test.test_can_recv(0x40);
   }
+  SECTION("chunked_can_receive_ring_wrap") {
+    test.test_can_recv(0x40, RECV_RING_SIZE - 3);
+  }
+}
+
+TEST_CASE("benchmark CAN receive", "[.benchmark]") {
+  auto can_list_size = GENERATE(100, 250);
+  PandaTest test(0, can_list_size, cereal::PandaState::PandaType::RED_PANDA);
+  test.benchmark_can_recv();
 }
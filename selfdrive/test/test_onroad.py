@@ -1,4 +1,3 @@
-import bz2
 import math
 import json
 import os
@@ -106,10 +105,10 @@ class TestOnroad:
   @classmethod
   def setup_class(cls):
     if "DEBUG" in os.environ:
-      segs = filter(lambda x: os.path.exists(os.path.join(x, "rlog")), Path(Paths.log_root()).iterdir())
+      segs = filter(lambda x: os.path.exists(os.path.join(x, "rlog.zst")), Path(Paths.log_root()).iterdir())
       segs = sorted(segs, key=lambda x: x.stat().st_mtime)
       print(segs[-3])
-      cls.lr = list(LogReader(os.path.join(segs[-3], "rlog")))
+      cls.lr = list(LogReader(os.path.join(segs[-3], "rlog.zst")))
       return
 
     # setup env
@@ -158,19 +157,17 @@ class TestOnroad:
         if proc.wait(60) is None:
           proc.kill()
 
-    cls.lrs = [list(LogReader(os.path.join(str(s), "rlog"))) for s in cls.segments]
+    cls.lrs = [list(LogReader(os.path.join(str(s), "rlog.zst"))) for s in cls.segments]
 
     # use the second segment by default as it's the first full segment
-    cls.lr = list(LogReader(os.path.join(str(cls.segments[1]), "rlog")))
+    cls.lr = list(LogReader(os.path.join(str(cls.segments[1]), "rlog.zst")))
     cls.log_path = cls.segments[1]
 
+    # the logs are written zstd compressed, their size on disk is what gets uploaded
     cls.log_sizes = {}
     for f in cls.log_path.iterdir():
       assert f.is_file()
-      cls.log_sizes[f]  = f.stat().st_size / 1e6
-      if f.name in ("qlog", "rlog"):
-        with open(f, 'rb') as ff:
-          cls.log_sizes[f] = len(bz2.compress(ff.read())) / 1e6
+      cls.log_sizes[f] = f.stat().st_size / 1e6
 
 
   @cached_property
@@ -206,10 +203,12 @@ class TestOnroad:
     for f, sz in self.log_sizes.items():
       if f.name == "qcamera.ts":
         assert 2.15 < sz < 2.35
-      elif f.name == "qlog":
-        assert 0.6 < sz < 1.0
-      elif f.name == "rlog":
-        assert 5 < sz < 50
+      elif f.name == "qlog.zst":
+        assert 0.6 < sz < 1.3
+      elif f.name == "rlog.zst":
+        assert 5 < sz < 55
+      elif f.name in ("qlog.idx", "rlog.idx"):
+        assert sz < 0.05
       elif f.name.endswith('.hevc'):
         assert 70 < sz < 77
       else:
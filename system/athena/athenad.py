@@ -23,6 +23,7 @@ from typing import cast
 from collections.abc import Callable
 
 import requests
+import zstandard as zstd
 from jsonrpc import JSONRPCResponseManager, dispatcher
 from websocket import (ABNF, WebSocket, WebSocketException, WebSocketTimeoutException,
                        create_connection)
@@ -111,6 +112,15 @@ def strip_bz2_extension(fn: str) -> str:
   return fn
 
 
+def get_upload_source(path: str) -> str | None:
+  # A .bz2 file that does not exist is compressed on the fly from the file without the extension.
+  # loggerd writes zstd logs, so a requested rlog.bz2/qlog.bz2 is recompressed from rlog.zst/qlog.zst.
+  candidates = [path, strip_bz2_extension(path)]
+  if path.endswith('.bz2') and os.path.basename(path) in ('rlog.bz2', 'qlog.bz2'):
+    candidates.append(strip_bz2_extension(path) + '.zst')
+  return next((fn for fn in candidates if os.path.exists(fn)), None)
+
+
 class AbortTransferException(Exception):
   pass
 
@@ -282,18 +292,15 @@ def upload_handler(end_event: threading.Event) -> None:
 
 
 def _do_upload(upload_item: UploadItem, callback: Callable = None) -> requests.Response:
-  path = upload_item.path
-  compress = False
-
-  # If file does not exist, but does exist without the .bz2 extension we will compress on the fly
-  if not os.path.exists(path) and os.path.exists(strip_bz2_extension(path)):
-    path = strip_bz2_extension(path)
-    compress = True
+  path = get_upload_source(upload_item.path) or upload_item.path
+  compress = path != upload_item.path
 
   with open(path, "rb") as f:
     content = f.read()
     if compress:
       cloudlog.event("athena.upload_handler.compress", fn=path, fn_orig=upload_item.path)
+      if path.endswith('.zst'):
+        content = zstd.ZstdDecompressor().stream_reader(io.BytesIO(content), read_across_frames=True).read()
       content = bz2.compress(content)
 
   with io.BytesIO(content) as data:
@@ -390,7 +397,7 @@ def uploadFilesToUrls(files_data: list[UploadFileDict]) -> UploadFilesToUrlRespo
       continue
 
     path = os.path.join(Paths.log_root(), file.fn)
-    if not os.path.exists(path) and not os.path.exists(strip_bz2_extension(path)):
+    if get_upload_source(path) is None:
       failed.append(file.fn)
       continue
 
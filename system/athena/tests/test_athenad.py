@@ -1,4 +1,5 @@
 import pytest
+import bz2
 from functools import wraps
 import json
 import multiprocessing
@@ -8,6 +9,7 @@ import shutil
 import time
 import threading
 import queue
+import zstandard as zstd
 from dataclasses import asdict, replace
 from datetime import datetime, timedelta
 
@@ -193,6 +195,31 @@ class TestAthenadMethods:
     resp = athenad._do_upload(item)
     assert resp.status_code == 201
 
+  @pytest.mark.parametrize("log", ["rlog", "qlog"])
+  def test_do_upload_zst(self, mocker, log):
+    # loggerd writes several zstd frames, a request for the .bz2 log gets them recompressed
+    dat = os.urandom(1024 * 1024)
+    fn = self._create_file(f'{log}.zst', data=b''.join(zstd.ZstdCompressor().compress(dat[i:i + 256 * 1024])
+                                                        for i in range(0, len(dat), 256 * 1024)))
+
+    uploaded = []
+    mocker.patch('openpilot.system.athena.athenad.requests.put', side_effect=lambda url, data, **kwargs: uploaded.append(data.read()))
+    item = athenad.UploadItem(path=fn[:-4] + '.bz2', url=f"http://localhost:1238/{log}.bz2", headers={}, created_at=int(time.time()*1000), id='')
+    athenad._do_upload(item)
+    assert bz2.decompress(uploaded[0]) == dat
+
+  def test_upload_file_to_url_zst(self, host):
+    fn = self._create_file('rlog.zst')
+
+    resp = dispatcher["uploadFileToUrl"]("rlog.bz2", f"{host}/rlog.bz2", {})
+    assert resp['enqueued'] == 1
+    assert resp['items'][0]['path'] == fn[:-4] + '.bz2'
+
+    # only logs are written as zstd
+    self._create_file('qcamera.zst')
+    resp = dispatcher["uploadFileToUrl"]("qcamera.bz2", f"{host}/qcamera.bz2", {})
+    assert resp == {'enqueued': 0, 'items': [], 'failed': ['qcamera.bz2']}
+
   def test_upload_file_to_url(self, host):
     fn = self._create_file('qlog.bz2')
 
@@ -7,6 +7,7 @@
 #include <jpeglib.h>
 
 #include "common/clutil.h"
+#include "common/nv12_scale.h"
 #include "common/swaglog.h"
 #include "third_party/linux/include/msm_media_info.h"
 
@@ -169,30 +170,13 @@ kj::Array<uint8_t> get_raw_frame_image(const CameraBuf *b) {
 }
 
 static kj::Array<capnp::byte> yuv420_to_jpeg(const CameraBuf *b, int thumbnail_width, int thumbnail_height) {
-  int downscale = b->cur_yuv_buf->width / thumbnail_width;
-  assert(downscale * thumbnail_height == b->cur_yuv_buf->height);
-  int in_stride = b->cur_yuv_buf->stride;
-
   // make the buffer big enough. jpeg_write_raw_data requires 16-pixels aligned height to be used.
   std::unique_ptr<uint8[]> buf(new uint8_t[(thumbnail_width * ((thumbnail_height + 15) & ~15) * 3) / 2]);
   uint8_t *y_plane = buf.get();
   uint8_t *u_plane = y_plane + thumbnail_width * thumbnail_height;
   uint8_t *v_plane = u_plane + (thumbnail_width * thumbnail_height) / 4;
-  {
-    // subsampled conversion from nv12 to yuv
-    for (int hy = 0; hy < thumbnail_height/2; hy++) {
-      for (int hx = 0; hx < thumbnail_width/2; hx++) {
-        int ix = hx * downscale + (downscale-1)/2;
-        int iy = hy * downscale + (downscale-1)/2;
-        y_plane[(hy*2 + 0)*thumbnail_width + (hx*2 + 0)] = b->cur_yuv_buf->y[(iy*2 + 0) * in_stride + ix*2 + 0];
-        y_plane[(hy*2 + 0)*thumbnail_width + (hx*2 + 1)] = b->cur_yuv_buf->y[(iy*2 + 0) * in_stride + ix*2 + 1];
-        y_plane[(hy*2 + 1)*thumbnail_width + (hx*2 + 0)] = b->cur_yuv_buf->y[(iy*2 + 1) * in_stride + ix*2 + 0];
-        y_plane[(hy*2 + 1)*thumbnail_width + (hx*2 + 1)] = b->cur_yuv_buf->y[(iy*2 + 1) * in_stride + ix*2 + 1];
-        u_plane[hy*thumbnail_width/2 + hx] = b->cur_yuv_buf->uv[iy*in_stride + ix*2 + 0];
-        v_plane[hy*thumbnail_width/2 + hx] = b->cur_yuv_buf->uv[iy*in_stride + ix*2 + 1];
-      }
-    }
-  }
+  Nv12Scaler(b->cur_yuv_buf->width, b->cur_yuv_buf->height, thumbnail_width, thumbnail_height)
+    .scale(b->cur_yuv_buf->y, b->cur_yuv_buf->uv, b->cur_yuv_buf->stride, y_plane);
 
   struct jpeg_compress_struct cinfo;
   struct jpeg_error_mgr jerr;
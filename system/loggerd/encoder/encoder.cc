@@ -1,5 +1,7 @@
 #include "system/loggerd/encoder/encoder.h"
 
+#include <algorithm>
+
 VideoEncoder::VideoEncoder(const EncoderInfo &encoder_info, int in_width, int in_height)
     : encoder_info(encoder_info), in_width(in_width), in_height(in_height) {
 
@@ -12,6 +14,14 @@ VideoEncoder::VideoEncoder(const EncoderInfo &encoder_info, int in_width, int in
     pubs.push_back(encoder_info.thumbnail_name);
   }
   pm.reset(new PubMaster(pubs));
+
+  // the packets loggerd writes go through shared memory, ENCODERD_INLINE_PACKETS keeps them in the
+  // messages for subscribers on other devices, like tools/camerastream. The lossless frames of PCs don't fit.
+  if (encoder_info.packet_ring && encoder_info.encode_type != cereal::EncodeIndex::Type::BIG_BOX_LOSSLESS &&
+      !getenv("ENCODERD_INLINE_PACKETS")) {
+    size_t size = std::max<size_t>(PACKET_RING_MIN_SIZE, (size_t)encoder_info.bitrate / 8 * PACKET_RING_SECONDS);
+    ring = PacketRing::create(encoder_info.publish_name, size);
+  }
 }
 
 void VideoEncoder::publisher_publish(VideoEncoder *e, int segment_num, uint32_t idx, VisionIpcBufExtra &extra,
@@ -33,10 +43,20 @@ void VideoEncoder::publisher_publish(VideoEncoder *e, int segment_num, uint32_t
   edata.setSegmentId(idx);
   edata.setFlags(flags);
   edata.setLen(dat.size());
-  edat.setData(dat);
   edat.setWidth(out_width);
   edat.setHeight(out_height);
-  if (flags & V4L2_BUF_FLAG_KEYFRAME) edat.setHeader(header);
+
+  // only the offset goes in the message if the packet fits in the ring
+  const size_t header_len = (flags & V4L2_BUF_FLAG_KEYFRAME) ? header.size() : 0;
+  const int64_t ring_offset = e->ring ? e->ring->write({{header.begin(), header_len}, {dat.begin(), dat.size()}}) : -1;
+  if (ring_offset >= 0) {
+    edat.setInRing(true);
+    edat.setRingOffset(ring_offset);
+    edat.setRingHeaderLen(header_len);
+  } else {
+    edat.setData(dat);
+    if (flags & V4L2_BUF_FLAG_KEYFRAME) edat.setHeader(header);
+  }
 
   uint32_t bytes_size = capnp::computeSerializedSizeInWords(msg) * sizeof(capnp::word);
   if (e->msg_cache.size() < bytes_size) {
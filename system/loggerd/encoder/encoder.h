@@ -11,6 +11,7 @@
 #include "common/queue.h"
 #include "system/camerad/cameras/camera_common.h"
 #include "system/loggerd/loggerd.h"
+#include "system/loggerd/packet_ring.h"
 
 #define V4L2_BUF_FLAG_KEYFRAME 8
 
@@ -35,5 +36,6 @@ private:
   // total frames encoded
   int cnt = 0;
   std::unique_ptr<PubMaster> pm;
+  std::unique_ptr<PacketRing> ring;
   std::vector<capnp::byte> msg_cache;
 };
@@ -35,10 +35,11 @@ FfmpegEncoder::FfmpegEncoder(const EncoderInfo &encoder_info, int in_width, int
   frame->linesize[1] = out_width/2;
   frame->linesize[2] = out_width/2;
 
-  convert_buf.resize(in_width * in_height * 3 / 2);
-
   if (in_width != out_width || in_height != out_height) {
+    scaler = std::make_unique<Nv12Scaler>(in_width, in_height, out_width, out_height);
     downscale_buf.resize(out_width * out_height * 3 / 2);
+  } else {
+    convert_buf.resize(in_width * in_height * 3 / 2);
   }
 }
 
@@ -56,6 +57,9 @@ void FfmpegEncoder::encoder_open(const char* path) {
   this->codec_ctx->height = frame->height;
   this->codec_ctx->pix_fmt = AV_PIX_FMT_YUV420P;
   this->codec_ctx->time_base = (AVRational){ 1, encoder_info.fps };
+  // frame or slice threads, whichever the codec supports. 0 is a thread per core
+  this->codec_ctx->thread_count = util::getenv("ENCODERD_FFMPEG_THREADS", 0);
+  this->codec_ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
   int err = avcodec_open2(this->codec_ctx, codec, NULL);
   assert(err >= 0);
 
@@ -67,6 +71,11 @@ void FfmpegEncoder::encoder_open(const char* path) {
 void FfmpegEncoder::encoder_close() {
   if (!is_open) return;
 
+  // flush the frames still in the encoder's threads into this segment
+  avcodec_send_frame(this->codec_ctx, NULL);
+  receive_packets();
+  extras.clear();
+
   avcodec_free_context(&codec_ctx);
   is_open = false;
 }
@@ -75,33 +84,23 @@ int FfmpegEncoder::encode_frame(VisionBuf* buf, VisionIpcBufExtra *extra) {
   assert(buf->width == this->in_width);
   assert(buf->height == this->in_height);
 
-  uint8_t *cy = convert_buf.data();
-  uint8_t *cu = cy + in_width * in_height;
-  uint8_t *cv = cu + (in_width / 2) * (in_height / 2);
-  libyuv::NV12ToI420(buf->y, buf->stride,
-                     buf->uv, buf->stride,
-                     cy, in_width,
-                     cu, in_width/2,
-                     cv, in_width/2,
-                     in_width, in_height);
-
-  if (downscale_buf.size() > 0) {
+  if (scaler) {
+    // downscale and convert in one pass, only reading the sampled pixels of the full frame
     uint8_t *out_y = downscale_buf.data();
-    uint8_t *out_u = out_y + frame->width * frame->height;
-    uint8_t *out_v = out_u + (frame->width / 2) * (frame->height / 2);
-    libyuv::I420Scale(cy, in_width,
-                      cu, in_width/2,
-                      cv, in_width/2,
-                      in_width, in_height,
-                      out_y, frame->width,
-                      out_u, frame->width/2,
-                      out_v, frame->width/2,
-                      frame->width, frame->height,
-                      libyuv::kFilterNone);
+    scaler->scale(buf->y, buf->uv, buf->stride, out_y);
     frame->data[0] = out_y;
-    frame->data[1] = out_u;
-    frame->data[2] = out_v;
+    frame->data[1] = out_y + frame->width * frame->height;
+    frame->data[2] = frame->data[1] + (frame->width / 2) * (frame->height / 2);
   } else {
+    uint8_t *cy = convert_buf.data();
+    uint8_t *cu = cy + in_width * in_height;
+    uint8_t *cv = cu + (in_width / 2) * (in_height / 2);
+    libyuv::NV12ToI420(buf->y, buf->stride,
+                       buf->uv, buf->stride,
+                       cy, in_width,
+                       cu, in_width/2,
+                       cv, in_width/2,
+                       in_width, in_height);
     frame->data[0] = cy;
     frame->data[1] = cu;
     frame->data[2] = cv;
@@ -109,42 +108,45 @@ int FfmpegEncoder::encode_frame(VisionBuf* buf, VisionIpcBufExtra *extra) {
   frame->pts = counter*50*1000; // 50ms per frame
 
   int ret = counter;
-
+  extras.push_back(*extra);
   int err = avcodec_send_frame(this->codec_ctx, frame);
   if (err < 0) {
     LOGE("avcodec_send_frame error %d", err);
-    ret = -1;
+    extras.pop_back();
+    return -1;
   }
+  return receive_packets() ? ret : -1;
+}
 
+// publishes the packets the encoder has ready. With frame threading, a packet is for a frame sent a few frames before
+bool FfmpegEncoder::receive_packets() {
   AVPacket pkt;
   av_init_packet(&pkt);
   pkt.data = NULL;
   pkt.size = 0;
-  while (ret >= 0) {
-    err = avcodec_receive_packet(this->codec_ctx, &pkt);
-    if (err == AVERROR_EOF) {
-      break;
-    } else if (err == AVERROR(EAGAIN)) {
+  while (true) {
+    int err = avcodec_receive_packet(this->codec_ctx, &pkt);
+    if (err == AVERROR_EOF || err == AVERROR(EAGAIN)) {
       // Encoder might need a few frames on startup to get started. Keep going
-      ret = 0;
       break;
     } else if (err < 0) {
       LOGE("avcodec_receive_packet error %d", err);
-      ret = -1;
-      break;
+      return false;
     }
 
+    VisionIpcBufExtra extra = extras.front();
+    extras.pop_front();
     if (env_debug_encoder) {
-      printf("%20s got %8d bytes flags %8x idx %4d id %8d\n", encoder_info.publish_name, pkt.size, pkt.flags, counter, extra->frame_id);
+      printf("%20s got %8d bytes flags %8x idx %4d id %8d\n", encoder_info.publish_name, pkt.size, pkt.flags, counter, extra.frame_id);
     }
 
-    publisher_publish(this, segment_num, counter, *extra,
+    publisher_publish(this, segment_num, counter, extra,
       (pkt.flags & AV_PKT_FLAG_KEY) ? V4L2_BUF_FLAG_KEYFRAME : 0,
       kj::arrayPtr<capnp::byte>(pkt.data, (size_t)0), // TODO: get the header
       kj::arrayPtr<capnp::byte>(pkt.data, pkt.size));
 
     counter++;
+    av_packet_unref(&pkt);
   }
-  av_packet_unref(&pkt);
-  return ret;
+  return true;
 }
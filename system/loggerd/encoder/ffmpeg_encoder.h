@@ -2,6 +2,8 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -11,6 +13,7 @@ extern "C" {
 #include <libavutil/imgutils.h>
 }
 
+#include "common/nv12_scale.h"
 #include "system/loggerd/encoder/encoder.h"
 #include "system/loggerd/loggerd.h"
 
@@ -23,12 +26,17 @@ public:
   void encoder_close();
 
 private:
+  bool receive_packets();
+
   int segment_num = -1;
   int counter = 0;
   bool is_open = false;
 
   AVCodecContext *codec_ctx;
   AVFrame *frame = NULL;
+  // of the frames sent to the encoder that it hasn't returned packets for yet
+  std::deque<VisionIpcBufExtra> extras;
   std::vector<uint8_t> convert_buf;
+  std::unique_ptr<Nv12Scaler> scaler;
   std::vector<uint8_t> downscale_buf;
 };
@@ -1,5 +1,8 @@
 #include <cassert>
+#include <mutex>
 
+#include "common/histogram.h"
+#include "common/timing.h"
 #include "system/loggerd/loggerd.h"
 
 #ifdef QCOM2
@@ -12,6 +15,110 @@
 
 ExitHandler do_exit;
 
+// frames waiting for each encoder. The VisionBuf is camerad's, it holds the frame only until camerad
+// cycles back to it, so the queue stays far shorter than camerad's buffer count.
+#define ENCODER_QUEUE_SIZE 3
+
+static std::vector<float> encode_time_edges() {
+  std::vector<float> edges;
+  for (float ms = 1; ms <= 20; ms += 1) edges.push_back(ms);
+  for (float ms = 25; ms <= 50; ms += 5) edges.push_back(ms);
+  for (float ms : {75, 100, 150, 200, 500}) edges.push_back(ms);
+  return edges;
+}
+
+struct EncodeJob {
+  VisionBuf *buf;
+  VisionIpcBufExtra extra;
+  int segment;
+  uint64_t recv_time;
+};
+
+// runs one encoder on its own thread, so a slow encoder doesn't hold up the others of the camera
+class EncoderWorker {
+public:
+  EncoderWorker(const EncoderInfo &encoder_info, int width, int height)
+    : encoder(new Encoder(encoder_info, width, height)), name(encoder_info.publish_name) {
+    thread = std::thread(&EncoderWorker::run, this);
+  }
+
+  ~EncoderWorker() {
+    jobs.push({.buf = nullptr});
+    thread.join();
+  }
+
+  // false if the queue is full and the frame is dropped
+  bool push(const EncodeJob &job) {
+    size_t depth = jobs.size();
+    std::lock_guard lk(lock);
+    max_queue_depth = std::max<uint32_t>(max_queue_depth, depth + 1);
+    if (depth >= ENCODER_QUEUE_SIZE) {
+      ++frames_dropped;
+      return false;
+    }
+    jobs.push(job);
+    return true;
+  }
+
+  void stats(cereal::EncoderStats::Encoder::Builder e) {
+    std::lock_guard lk(lock);
+    e.setPublishName(name);
+    e.setFramesEncoded(frames_encoded);
+    e.setFramesDropped(frames_dropped);
+    e.setFramesOverwritten(frames_overwritten);
+    e.setMaxQueueDepth(max_queue_depth);
+    encode_time.to_capnp(e.initEncodeTimeMs());
+    e.setEncodeTimeMaxMs(encode_time.max_value);
+    queue_time.to_capnp(e.initQueueTimeMs());
+
+    frames_encoded = frames_dropped = frames_overwritten = max_queue_depth = 0;
+    encode_time.clear();
+    queue_time.clear();
+  }
+
+private:
+  void run() {
+    util::set_thread_name(("encoder_" + name).c_str());
+    int cur_seg = -1;
+    for (EncodeJob job = jobs.pop(); job.buf != nullptr; job = jobs.pop()) {
+      if (job.buf->get_frame_id() != job.extra.frame_id) {
+        std::lock_guard lk(lock);
+        ++frames_overwritten;
+        continue;
+      }
+
+      // do rotation if required
+      if (job.segment != cur_seg) {
+        if (cur_seg != -1) encoder->encoder_close();
+        encoder->encoder_open(NULL);
+        cur_seg = job.segment;
+      }
+
+      const uint64_t start = nanos_since_boot();
+      int out_id = encoder->encode_frame(job.buf, &job.extra);
+      const uint64_t end = nanos_since_boot();
+      if (out_id == -1) {
+        LOGE("Failed to encode frame. frame_id: %d", job.extra.frame_id);
+      }
+
+      std::lock_guard lk(lock);
+      ++frames_encoded;
+      encode_time.add((end - start) / 1e6);
+      queue_time.add((start - job.recv_time) / 1e6);
+    }
+  }
+
+  std::unique_ptr<Encoder> encoder;
+  const std::string name;
+  SafeQueue<EncodeJob> jobs;
+  std::thread thread;
+
+  std::mutex lock;
+  uint32_t frames_encoded = 0, frames_dropped = 0, frames_overwritten = 0, max_queue_depth = 0;
+  TelemetryHistogram encode_time{encode_time_edges()};
+  TelemetryHistogram queue_time{encode_time_edges()};
+};
+
 struct EncoderdState {
   int max_waiting = 0;
 
@@ -20,6 +127,10 @@ struct EncoderdState {
   std::atomic<uint32_t> start_frame_id = 0;
   bool camera_ready[WideRoadCam + 1] = {};
   bool camera_synced[WideRoadCam + 1] = {};
+
+  // every encoder's worker, for the stats
+  std::mutex workers_lock;
+  std::vector<std::shared_ptr<EncoderWorker>> workers;
 };
 
 // Handle initial encoder syncing by waiting for all encoders to reach the same frame id
@@ -47,7 +158,7 @@ bool sync_encoders(EncoderdState *s, CameraType cam_type, uint32_t frame_id) {
 void encoder_thread(EncoderdState *s, const LogCameraInfo &cam_info) {
   util::set_thread_name(cam_info.thread_name);
 
-  std::vector<std::unique_ptr<Encoder>> encoders;
+  std::vector<std::shared_ptr<EncoderWorker>> workers;
   VisionIpcClient vipc_client = VisionIpcClient("camerad", cam_info.stream_type, false);
 
   int cur_seg = 0;
@@ -58,15 +169,16 @@ void encoder_thread(EncoderdState *s, const LogCameraInfo &cam_info) {
     }
 
     // init encoders
-    if (encoders.empty()) {
+    if (workers.empty()) {
       VisionBuf buf_info = vipc_client.buffers[0];
       LOGW("encoder %s init %zux%zu", cam_info.thread_name, buf_info.width, buf_info.height);
       assert(buf_info.width > 0 && buf_info.height > 0);
 
       for (const auto &encoder_info : cam_info.encoder_infos) {
-        auto &e = encoders.emplace_back(new Encoder(encoder_info, buf_info.width, buf_info.height));
-        e->encoder_open(nullptr);
+        workers.push_back(std::make_shared<EncoderWorker>(encoder_info, buf_info.width, buf_info.height));
       }
+      std::lock_guard lk(s->workers_lock);
+      s->workers.insert(s->workers.end(), workers.begin(), workers.end());
     }
 
     bool lagging = false;
@@ -74,6 +186,7 @@ void encoder_thread(EncoderdState *s, const LogCameraInfo &cam_info) {
       VisionIpcBufExtra extra;
       VisionBuf* buf = vipc_client.recv(&extra);
       if (buf == nullptr) continue;
+      const uint64_t recv_time = nanos_since_boot();
 
       // detect loop around and drop the frames
       if (buf->get_frame_id() != extra.frame_id) {
@@ -90,22 +203,16 @@ void encoder_thread(EncoderdState *s, const LogCameraInfo &cam_info) {
       }
       if (do_exit) break;
 
-      // do rotation if required
+      // do rotation if required, the workers rotate when they get to the first frame of the new segment
       const int frames_per_seg = SEGMENT_LENGTH * MAIN_FPS;
       if (cur_seg >= 0 && extra.frame_id >= ((cur_seg + 1) * frames_per_seg) + s->start_frame_id) {
-        for (auto &e : encoders) {
-          e->encoder_close();
-          e->encoder_open(NULL);
-        }
         ++cur_seg;
       }
 
-      // encode a frame
-      for (int i = 0; i < encoders.size(); ++i) {
-        int out_id = encoders[i]->encode_frame(buf, &extra);
-
-        if (out_id == -1) {
-          LOGE("Failed to encode frame. frame_id: %d", extra.frame_id);
+      // hand the frame to every encoder
+      for (auto &w : workers) {
+        if (!w->push({.buf = buf, .extra = extra, .segment = cur_seg, .recv_time = recv_time})) {
+          LOGE_100("encoder %s lag, dropped frame %d", cam_info.thread_name, extra.frame_id);
         }
       }
     }
@@ -113,7 +220,8 @@ void encoder_thread(EncoderdState *s, const LogCameraInfo &cam_info) {
 }
 
 template <size_t N>
-void encoderd_thread(const LogCameraInfo (&cameras)[N]) {
+void encoderd_thread(const LogCameraInfo (&cameras)[N], const char *stats_service,
+                     cereal::EncoderStats::Builder (cereal::Event::Builder::*init_stats)()) {
   EncoderdState s;
 
   std::set<VisionStreamType> streams;
@@ -135,6 +243,19 @@ void encoderd_thread(const LogCameraInfo (&cameras)[N]) {
       encoder_threads.push_back(std::thread(encoder_thread, &s, *it));
     }
 
+    // publish the encoders' stats once a second
+    PubMaster pm({stats_service});
+    while (!do_exit) {
+      util::sleep_for(1000);
+      MessageBuilder msg;
+      std::lock_guard lk(s.workers_lock);
+      auto encoders = (msg.initEvent().*init_stats)().initEncoders(s.workers.size());
+      for (int i = 0; i < s.workers.size(); ++i) {
+        s.workers[i]->stats(encoders[i]);
+      }
+      pm.send(stats_service, msg);
+    }
+
     for (auto &t : encoder_threads) t.join();
   }
 }
@@ -150,12 +271,12 @@ int main(int argc, char* argv[]) {
   if (argc > 1) {
     std::string arg1(argv[1]);
     if (arg1 == "--stream") {
-      encoderd_thread(stream_cameras_logged);
+      encoderd_thread(stream_cameras_logged, "livestreamEncoderStats", &cereal::Event::Builder::initLivestreamEncoderStats);
     } else {
       LOGE("Argument '%s' is not supported", arg1.c_str());
     }
   } else {
-    encoderd_thread(cameras_logged);
+    encoderd_thread(cameras_logged, "encoderStats", &cereal::Event::Builder::initEncoderStats);
   }
   return 0;
 }
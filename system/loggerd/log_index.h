@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Sidecar index of a zstd log, written by loggerd next to the log (rlog.zst -> rlog.idx).
+// There is one entry per zstd frame, the smallest unit that can be decompressed on its own, so a
+// reader can find the frames holding a time range or a set of services and decompress only those.
+const uint32_t LOG_INDEX_MAGIC = 0x78646e69;  // "indx"
+const uint32_t LOG_INDEX_VERSION = 1;
+const int LOG_INDEX_MAX_SERVICES = 256;
+
+struct LogIndexEntry {
+  uint64_t offset = 0;             // of the compressed frame in the log
+  uint32_t size = 0;               // compressed
+  uint32_t decompressed_size = 0;
+  uint64_t min_mono_time = UINT64_MAX, max_mono_time = 0;
+  uint64_t services[LOG_INDEX_MAX_SERVICES / 64] = {};  // bitset of the cereal::Event::Which in the frame
+
+  inline void add(uint64_t mono_time, uint16_t which) {
+    min_mono_time = std::min(min_mono_time, mono_time);
+    max_mono_time = std::max(max_mono_time, mono_time);
+    if (which < LOG_INDEX_MAX_SERVICES) services[which / 64] |= 1ULL << (which % 64);
+  }
+  inline bool hasService(uint16_t which) const {
+    return which < LOG_INDEX_MAX_SERVICES && (services[which / 64] >> (which % 64)) & 1;
+  }
+};
+
+inline std::string log_index_path(const std::string &log_path) {
+  const size_t ext = log_path.rfind(".zst");
+  return (ext == std::string::npos ? log_path : log_path.substr(0, ext)) + ".idx";
+}
+
+inline std::string log_index_serialize(const std::vector<LogIndexEntry> &entries) {
+  const uint32_t header[] = {LOG_INDEX_MAGIC, LOG_INDEX_VERSION};
+  std::string out((const char *)header, sizeof(header));
+  out.append((const char *)entries.data(), entries.size() * sizeof(LogIndexEntry));
+  return out;
+}
+
+// empty if the index is missing or from another version
+inline std::vector<LogIndexEntry> log_index_parse(const std::string &data) {
+  uint32_t header[2];
+  if (data.size() < sizeof(header)) return {};
+  memcpy(header, data.data(), sizeof(header));
+  if (header[0] != LOG_INDEX_MAGIC || header[1] != LOG_INDEX_VERSION) return {};
+
+  std::vector<LogIndexEntry> entries((data.size() - sizeof(header)) / sizeof(LogIndexEntry));
+  memcpy(entries.data(), data.data() + sizeof(header), entries.size() * sizeof(LogIndexEntry));
+  return entries;
+}
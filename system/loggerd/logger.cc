@@ -1,5 +1,8 @@
 #include "system/loggerd/logger.h"
 
+#include <unistd.h>
+
+#include <algorithm>
 #include <fstream>
 #include <map>
 #include <vector>
@@ -9,6 +12,7 @@
 
 #include "common/params.h"
 #include "common/swaglog.h"
+#include "common/timing.h"
 #include "common/version.h"
 
 // ***** log metadata *****
@@ -121,43 +125,104 @@ static void log_sentinel(LoggerState *log, SentinelType type, int exit_signal =
   log->write(msg.toBytes(), true);
 }
 
+LogSegment::LogSegment(const std::string &path, bool with_stats) : path(path), lock_file(path + "/rlog.lock") {
+  bool ret = util::create_directories(path, 0775);
+  assert(ret == true);
+  std::ofstream{lock_file};
+
+  rlog.reset(new ZstdFileWriter(path + "/rlog.zst", LOG_COMPRESSION_LEVEL, RLOG_BUFFER_SIZE, path + "/rlog.idx"));
+  qlog.reset(new ZstdFileWriter(path + "/qlog.zst", LOG_COMPRESSION_LEVEL, QLOG_BUFFER_SIZE, path + "/qlog.idx"));
+  if (with_stats) stats.reset(new SegmentStats());
+}
+
+LogSegment::~LogSegment() {
+  // finish compressing before the lock is released and the files can be uploaded
+  rlog.reset();
+  qlog.reset();
+  if (stats && stats->messages() > 0) {
+    const std::string json = stats->toJson();
+    if (util::write_file((path + "/stats.json").c_str(), json.data(), json.size(), O_WRONLY | O_CREAT | O_TRUNC) != 0) {
+      LOGE("failed to write segment stats of %s", path.c_str());
+    }
+  }
+  std::remove(lock_file.c_str());
+}
+
+static std::unique_ptr<LogSegment> open_segment(const std::string &path, bool with_stats) {
+  return std::make_unique<LogSegment>(path, with_stats);
+}
+
 LoggerState::LoggerState(const std::string &log_root) {
   route_name = logger_get_identifier("RouteCount");
   route_path = log_root + "/" + route_name;
   init_data = logger_build_init_data();
+  segment_stats = getenv("LOGGERD_SEGMENT_STATS") != nullptr;
 }
 
 LoggerState::~LoggerState() {
-  if (rlog) {
+  if (seg) {
     log_sentinel(this, SentinelType::END_OF_ROUTE, exit_signal);
-    std::remove(lock_file.c_str());
+    seg.reset();
+  }
+  if (closing.valid()) {
+    closing.wait();
+  }
+
+  // the next segment was opened ahead but never used
+  if (next_seg.valid()) {
+    auto unused = next_seg.get();
+    std::string path = unused->path;
+    unused.reset();
+    for (const char *fn : {"/rlog.zst", "/qlog.zst", "/rlog.idx", "/qlog.idx"}) {
+      std::remove((path + fn).c_str());
+    }
+    rmdir(path.c_str());
   }
 }
 
 bool LoggerState::next() {
-  if (rlog) {
+  const uint64_t start = nanos_since_boot();
+  if (seg) {
     log_sentinel(this, SentinelType::END_OF_SEGMENT);
-    std::remove(lock_file.c_str());
-  }
+    LOG("segment %d: max write stall %.2fms, rlog high water %zu KB in %zu buffers, qlog high water %zu KB in %zu buffers",
+        part, max_write_stall / 1e6, seg->rlog->highWaterBytes() / 1024, seg->rlog->highWaterBuffers(),
+        seg->qlog->highWaterBytes() / 1024, seg->qlog->highWaterBuffers());
 
-  segment_path = route_path + "--" + std::to_string(++part);
-  bool ret = util::create_directories(segment_path, 0775);
-  assert(ret == true);
-
-  const std::string rlog_path = segment_path + "/rlog";
-  lock_file = rlog_path + ".lock";
-  std::ofstream{lock_file};
+    if (closing.valid()) {
+      closing.wait();
+    }
+    closing = std::async(std::launch::async, [s = std::move(seg)]() mutable { s.reset(); });
+  }
 
-  rlog.reset(new RawFile(rlog_path));
-  qlog.reset(new RawFile(segment_path + "/qlog"));
+  ++part;
+  seg = next_seg.valid() ? next_seg.get() : open_segment(route_path + "--" + std::to_string(part), segment_stats);
+  segment_path = seg->path;
+  next_seg = std::async(std::launch::async, open_segment, route_path + "--" + std::to_string(part + 1), segment_stats);
 
   // log init data & sentinel type.
   write(init_data.asBytes(), true);
   log_sentinel(this, part > 0 ? SentinelType::START_OF_SEGMENT : SentinelType::START_OF_ROUTE);
+  max_write_stall = nanos_since_boot() - start;
   return true;
 }
 
 void LoggerState::write(uint8_t* data, size_t size, bool in_qlog) {
-  rlog->write(data, size);
-  if (in_qlog) qlog->write(data, size);
+  const uint64_t start = nanos_since_boot();
+
+  // only the root pointer is read, for the index
+  uint64_t mono_time = 0;
+  uint16_t which = UINT16_MAX;
+  try {
+    capnp::FlatArrayMessageReader reader(kj::ArrayPtr<const capnp::word>((const capnp::word *)data, size / sizeof(capnp::word)));
+    auto event = reader.getRoot<cereal::Event>();
+    mono_time = event.getLogMonoTime();
+    which = event.which();
+    if (seg->stats) seg->stats->update(event, size);
+  } catch (const kj::Exception &e) {
+    LOGE_100("failed to index event: %s", e.getDescription().cStr());
+  }
+
+  seg->rlog->write(data, size, mono_time, which);
+  if (in_qlog) seg->qlog->write(data, size, mono_time, which);
+  max_write_stall = std::max(max_write_stall, nanos_since_boot() - start);
 }
@@ -1,12 +1,20 @@
 #pragma once
 
 #include <cassert>
+#include <future>
 #include <memory>
 #include <string>
 
 #include "cereal/messaging/messaging.h"
 #include "common/util.h"
 #include "system/hardware/hw.h"
+#include "system/loggerd/segment_stats.h"
+#include "system/loggerd/zstd_writer.h"
+
+const int LOG_COMPRESSION_LEVEL = 10;
+// size of each of the double buffers of the log writers, a frame is closed before it grows larger
+const size_t RLOG_BUFFER_SIZE = 8 * 1024 * 1024;
+const size_t QLOG_BUFFER_SIZE = 1024 * 1024;
 
 class RawFile {
  public:
@@ -31,6 +39,17 @@ class RawFile {
 
 typedef cereal::Sentinel::SentinelType SentinelType;
 
+// the files of a segment. The next segment is opened in the background ahead of the rotation to
+// it, and a finished segment is closed in the background.
+struct LogSegment {
+  LogSegment(const std::string &path, bool with_stats = false);
+  ~LogSegment();
+
+  const std::string path, lock_file;
+  std::unique_ptr<ZstdFileWriter> rlog, qlog;
+  // written to stats.json on close
+  std::unique_ptr<SegmentStats> stats;
+};
 
 class LoggerState {
 public:
@@ -46,9 +65,16 @@ public:
 
 protected:
   int part = -1, exit_signal = 0;
-  std::string route_path, route_name, segment_path, lock_file;
+  std::string route_path, route_name, segment_path;
   kj::Array<capnp::word> init_data;
-  std::unique_ptr<RawFile> rlog, qlog;
+  std::unique_ptr<LogSegment> seg;
+  std::future<std::unique_ptr<LogSegment>> next_seg;
+  std::future<void> closing;
+  // LOGGERD_SEGMENT_STATS, summarize every segment in a stats.json
+  bool segment_stats = false;
+
+  // longest time the caller was blocked in write() or next() during the current segment
+  uint64_t max_write_stall = 0;
 };
 
 kj::Array<capnp::word> logger_build_init_data();
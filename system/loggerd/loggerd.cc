@@ -1,5 +1,6 @@
 #include <sys/xattr.h>
 
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <string>
@@ -9,6 +10,7 @@
 #include "common/params.h"
 #include "system/loggerd/encoder/encoder.h"
 #include "system/loggerd/loggerd.h"
+#include "system/loggerd/packet_ring.h"
 #include "system/loggerd/video_writer.h"
 
 ExitHandler do_exit;
@@ -55,6 +57,7 @@ void rotate_if_needed(LoggerdState *s) {
 
 struct RemoteEncoder {
   std::unique_ptr<VideoWriter> writer;
+  std::unique_ptr<PacketRing> ring;
   int encoderd_segment_offset;
   int current_segment = -1;
   std::vector<Message *> q;
@@ -62,6 +65,9 @@ struct RemoteEncoder {
   bool recording = false;
   bool marked_ready_to_rotate = false;
   bool seen_first_packet = false;
+  // after a packet is lost, the frames up to the next keyframe are dropped too
+  bool skip_to_keyframe = false;
+  std::vector<uint8_t> packet;  // copied out of the ring
 };
 
 int handle_encoder_msg(LoggerdState *s, Message *msg, std::string &name, struct RemoteEncoder &re, const EncoderInfo &encoder_info) {
@@ -93,6 +99,7 @@ int handle_encoder_msg(LoggerdState *s, Message *msg, std::string &name, struct
       }
       re.current_segment = s->logger.segment();
       re.marked_ready_to_rotate = false;
+      re.skip_to_keyframe = false;
       // we are in this segment now, process any queued messages before this one
       if (!re.q.empty()) {
         for (auto &qmsg : re.q) {
@@ -102,6 +109,30 @@ int handle_encoder_msg(LoggerdState *s, Message *msg, std::string &name, struct
       }
     }
 
+    // the packet is either in the message or in encoderd's packet ring
+    kj::ArrayPtr<const capnp::byte> header = edata.getHeader(), data = edata.getData();
+    if (edata.getInRing()) {
+      if (!re.ring) re.ring = PacketRing::open(name);
+      const uint32_t header_len = edata.getRingHeaderLen();
+      const uint8_t *packet = re.ring ? re.ring->read(edata.getRingOffset(), header_len + idx.getLen()) : nullptr;
+      // encoderd can overwrite the packet any time, so it's copied out and only used if it was still intact after
+      if (packet != nullptr) {
+        re.packet.assign(packet, packet + header_len + idx.getLen());
+        if (!re.ring->valid(edata.getRingOffset())) packet = nullptr;
+      }
+      if (packet == nullptr) {
+        // overwritten before loggerd got to it, or encoderd made a new ring which is opened again
+        LOGE_100("%s: packet %d is no longer in the ring, dropping frames until the next keyframe", name.c_str(), idx.getEncodeId());
+        re.ring.reset();
+        re.skip_to_keyframe = true;
+        ++re.dropped_frames;
+        delete msg;
+        return bytes_count;
+      }
+      header = {re.packet.data(), header_len};
+      data = {re.packet.data() + header_len, idx.getLen()};
+    }
+
     // if we aren't recording yet, try to start, since we are in the correct segment
     if (!re.recording) {
       if (flags & V4L2_BUF_FLAG_KEYFRAME) {
@@ -116,9 +147,9 @@ int handle_encoder_msg(LoggerdState *s, Message *msg, std::string &name, struct
           assert(encoder_info.filename != NULL);
           re.writer.reset(new VideoWriter(s->logger.segmentPath().c_str(),
             encoder_info.filename, idx.getType() != cereal::EncodeIndex::Type::FULL_H_E_V_C,
-            edata.getWidth(), edata.getHeight(), encoder_info.fps, idx.getType()));
+            edata.getWidth(), edata.getHeight(), encoder_info.fps, idx.getType(),
+            (size_t)encoder_info.bitrate / 8 * SEGMENT_LENGTH, LOGGERD_DIRECT_IO));
           // write the header
-          auto header = edata.getHeader();
           re.writer->write((uint8_t *)header.begin(), header.size(), idx.getTimestampEof()/1000, true, false);
         }
         re.recording = true;
@@ -134,9 +165,20 @@ int handle_encoder_msg(LoggerdState *s, Message *msg, std::string &name, struct
     // we have to be recording if we are here
     assert(re.recording);
 
+    // the frames after a lost one can't be decoded until the next keyframe
+    if (re.skip_to_keyframe) {
+      if (!(flags & V4L2_BUF_FLAG_KEYFRAME)) {
+        delete msg;
+        ++re.dropped_frames;
+        return bytes_count;
+      }
+      LOGW("%s: dropped %d packets up to the keyframe after a lost one", name.c_str(), re.dropped_frames);
+      re.dropped_frames = 0;
+      re.skip_to_keyframe = false;
+    }
+
     // if we are actually writing the video file, do so
     if (re.writer) {
-      auto data = edata.getData();
       re.writer->write((uint8_t *)data.begin(), data.size(), idx.getTimestampEof()/1000, false, flags & V4L2_BUF_FLAG_KEYFRAME);
     }
 
@@ -197,13 +239,38 @@ void handle_user_flag(LoggerdState *s) {
   prev_segment = s->logger.segment();
 }
 
+struct ServiceState {
+  std::string name;
+  int counter, freq;
+  bool encoder, user_flag;
+
+  int quantum, deficit = 0;
+  // ready and not drained yet, since ready_time
+  bool pending = false;
+  uint64_t ready_time = 0;
+  // messages drained since the socket became ready, the most since the last rotation, and the longest a
+  // message that was waiting when it became ready took to get drained
+  int backlog = 0, max_backlog = 0;
+  uint64_t max_latency = 0;
+};
+
+void log_drain_stats(int segment, std::unordered_map<SubSocket*, ServiceState> &service_state) {
+  std::string stats;
+  for (auto &[_, service] : service_state) {
+    if (service.max_backlog > service.quantum) {
+      stats += util::string_format(" %s %d/%d %.1fms,", service.name.c_str(), service.max_backlog, service.quantum, service.max_latency / 1e6);
+    }
+    service.max_backlog = 0;
+    service.max_latency = 0;
+  }
+  if (!stats.empty()) {
+    stats.pop_back();
+    LOG("segment %d: backlog/quantum and drain latency of backed up services:%s", segment, stats.c_str());
+  }
+}
+
 void loggerd_thread() {
   // setup messaging
-  typedef struct ServiceState {
-    std::string name;
-    int counter, freq;
-    bool encoder, user_flag;
-  } ServiceState;
   std::unordered_map<SubSocket*, ServiceState> service_state;
   std::unordered_map<SubSocket*, struct RemoteEncoder> remote_encoders;
 
@@ -220,12 +287,15 @@ void loggerd_thread() {
     SubSocket * sock = SubSocket::create(ctx.get(), it.name);
     assert(sock != NULL);
     poller->registerSocket(sock);
+    const bool user_flag = it.name == "userFlag";
     service_state[sock] = {
       .name = it.name,
       .counter = 0,
       .freq = it.decimation,
       .encoder = encoder,
-      .user_flag = it.name == "userFlag",
+      .user_flag = user_flag,
+      .quantum = (encoder || user_flag) ? LOGGERD_MAX_QUANTUM
+                                        : std::clamp(it.frequency / LOGGERD_QUANTUM_HZ, 1, LOGGERD_MAX_QUANTUM),
     };
   }
 
@@ -244,20 +314,41 @@ void loggerd_thread() {
 
   uint64_t msg_count = 0, bytes_count = 0;
   double start_ts = millis_since_boot();
+  int stats_segment = s.logger.segment();
+  // sockets that still had messages after their quantum in the last round
+  std::vector<SubSocket*> backed_up;
   while (!do_exit) {
-    // poll for new messages on all sockets
-    for (auto sock : poller->poll(1000)) {
-      if (do_exit) break;
-
+    // poll for new messages on all sockets, without waiting while some are backed up
+    std::vector<SubSocket*> ready = poller->poll(backed_up.empty() ? 1000 : 0);
+    const uint64_t poll_time = nanos_since_boot();
+    for (auto sock : ready) {
       ServiceState &service = service_state[sock];
+      if (service.pending) continue;
+
+      service.pending = true;
+      service.ready_time = poll_time;
+      service.backlog = 0;
+      backed_up.push_back(sock);
       if (service.user_flag) {
         handle_user_flag(&s);
       }
+    }
+
+    // deficit round robin: every socket that's ready or still backed up drains up to its quantum, then
+    // the sockets are polled again, so no burst delays the others, including the ones that only become
+    // ready during the round, by more than one round. Encoders and userFlag go first
+    ready = std::move(backed_up);
+    backed_up.clear();
+    std::stable_partition(ready.begin(), ready.end(), [&](SubSocket *sock) {
+      return service_state[sock].encoder || service_state[sock].user_flag;
+    });
+    for (auto sock : ready) {
+      if (do_exit) break;
 
-      // drain socket
-      int count = 0;
+      ServiceState &service = service_state[sock];
+      service.deficit += service.quantum;
       Message *msg = nullptr;
-      while (!do_exit && (msg = sock->receive(true))) {
+      while (service.deficit > 0 && (msg = sock->receive(true))) {
         const bool in_qlog = service.freq != -1 && (service.counter++ % service.freq == 0);
         if (service.encoder) {
           s.last_camera_seen_tms = millis_since_boot();
@@ -275,13 +366,26 @@ void loggerd_thread() {
           LOGD("%" PRIu64 " messages, %.2f msg/sec, %.2f KB/sec", msg_count, msg_count / seconds, bytes_count * 0.001 / seconds);
         }
 
-        count++;
-        if (count >= 200) {
-          LOGD("large volume of '%s' messages", service.name.c_str());
-          break;
-        }
+        service.deficit--;
+        service.backlog++;
+      }
+
+      if (service.deficit > 0) {
+        // drained, an idle socket doesn't save up a deficit
+        service.deficit = 0;
+        service.pending = false;
+        service.max_backlog = std::max(service.max_backlog, service.backlog);
+        service.max_latency = std::max(service.max_latency, nanos_since_boot() - service.ready_time);
+      } else {
+        LOGD("large volume of '%s' messages", service.name.c_str());
+        backed_up.push_back(sock);
       }
     }
+
+    if (s.logger.segment() != stats_segment) {
+      log_drain_stats(stats_segment, service_state);
+      stats_segment = s.logger.segment();
+    }
   }
 
   LOGW("closing logger");
@@ -20,6 +20,11 @@ const int QCAM_BITRATE = 256000;
 
 #define NO_CAMERA_PATIENCE 500  // fall back to time-based rotation if all cameras are dead
 
+// sockets are drained round robin, each gets a quantum of messages per round: the messages its service
+// publishes in 1/LOGGERD_QUANTUM_HZ seconds. Encoders, which gate the rotation, and userFlag get the most.
+#define LOGGERD_QUANTUM_HZ 10
+#define LOGGERD_MAX_QUANTUM 200
+
 #define INIT_ENCODE_FUNCTIONS(encode_type)                                \
   .get_encode_data_func = &cereal::Event::Reader::get##encode_type##Data, \
   .set_encode_idx_func = &cereal::Event::Builder::set##encode_type##Idx,  \
@@ -27,6 +32,8 @@ const int QCAM_BITRATE = 256000;
 
 const bool LOGGERD_TEST = getenv("LOGGERD_TEST");
 const int SEGMENT_LENGTH = LOGGERD_TEST ? atoi(getenv("LOGGERD_SEGMENT_LENGTH")) : 60;
+// write the video files with O_DIRECT, bypassing the page cache
+const bool LOGGERD_DIRECT_IO = getenv("LOGGERD_DIRECT_IO");
 
 constexpr char PRESERVE_ATTR_NAME[] = "user.preserve";
 constexpr char PRESERVE_ATTR_VALUE = '1';
@@ -36,6 +43,8 @@ public:
   const char *thumbnail_name = NULL;
   const char *filename = NULL;
   bool record = true;
+  // publish the packets through a PacketRing, for loggerd only
+  bool packet_ring = true;
   int frame_width = -1;
   int frame_height = -1;
   int fps = MAIN_FPS;
@@ -80,6 +89,7 @@ const EncoderInfo stream_road_encoder_info = {
   //.thumbnail_name = "thumbnail",
   .encode_type = cereal::EncodeIndex::Type::QCAMERA_H264,
   .record = false,
+  .packet_ring = false,
   .bitrate = LIVESTREAM_BITRATE,
   INIT_ENCODE_FUNCTIONS(LivestreamRoadEncode),
 };
@@ -88,6 +98,7 @@ const EncoderInfo stream_wide_road_encoder_info = {
   .publish_name = "livestreamWideRoadEncodeData",
   .encode_type = cereal::EncodeIndex::Type::QCAMERA_H264,
   .record = false,
+  .packet_ring = false,
   .bitrate = LIVESTREAM_BITRATE,
   INIT_ENCODE_FUNCTIONS(LivestreamWideRoadEncode),
 };
@@ -96,6 +107,7 @@ const EncoderInfo stream_driver_encoder_info = {
   .publish_name = "livestreamDriverEncodeData",
   .encode_type = cereal::EncodeIndex::Type::QCAMERA_H264,
   .record = false,
+  .packet_ring = false,
   .bitrate = LIVESTREAM_BITRATE,
   INIT_ENCODE_FUNCTIONS(LivestreamDriverEncode),
 };
@@ -0,0 +1,120 @@
+#include "system/loggerd/packet_ring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "common/swaglog.h"
+#include "common/util.h"
+
+// the data starts on its own cache line
+#define PACKET_RING_HEADER_SIZE 64
+
+std::string PacketRing::path(const std::string &name) {
+  std::string full_path = "/dev/shm/";
+  const char *prefix = std::getenv("OPENPILOT_PREFIX");
+  if (prefix) {
+    full_path += std::string(prefix) + "/";
+  }
+  return full_path + "packet_ring_" + name;
+}
+
+PacketRing::PacketRing(void *mem, size_t mem_size)
+    : mem(mem), mem_size(mem_size), header((Header *)mem), data((uint8_t *)mem + PACKET_RING_HEADER_SIZE),
+      data_size(mem_size - PACKET_RING_HEADER_SIZE) {
+  static_assert(sizeof(Header) <= PACKET_RING_HEADER_SIZE);
+}
+
+PacketRing::~PacketRing() {
+  munmap(mem, mem_size);
+}
+
+std::unique_ptr<PacketRing> PacketRing::create(const std::string &name, size_t size) {
+  const std::string fn = path(name);
+  int fd = HANDLE_EINTR(::open(fn.c_str(), O_RDWR | O_CREAT, 0664));
+  if (fd < 0) {
+    LOGE("failed to open packet ring %s: %s", fn.c_str(), strerror(errno));
+    return nullptr;
+  }
+
+  struct stat st = {};
+  fstat(fd, &st);
+  const size_t mem_size = size + PACKET_RING_HEADER_SIZE;
+  const bool reuse = (size_t)st.st_size == mem_size;
+  if (!reuse && ftruncate(fd, mem_size) != 0) {
+    LOGE("failed to resize packet ring %s: %s", fn.c_str(), strerror(errno));
+    close(fd);
+    return nullptr;
+  }
+  void *mem = mmap(NULL, mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    LOGE("failed to map packet ring %s: %s", fn.c_str(), strerror(errno));
+    return nullptr;
+  }
+
+  std::unique_ptr<PacketRing> ring(new PacketRing(mem, mem_size));
+  if (!reuse || ring->header->size != size) {
+    // a new ring, offsets of an older one still in msgq are past its end and fail to read
+    ring->header->size = size;
+    ring->header->write_end = 0;
+  }
+  return ring;
+}
+
+std::unique_ptr<PacketRing> PacketRing::open(const std::string &name) {
+  int fd = HANDLE_EINTR(::open(path(name).c_str(), O_RDONLY));
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat st = {};
+  fstat(fd, &st);
+  void *mem = st.st_size > PACKET_RING_HEADER_SIZE ? mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (mem == MAP_FAILED) {
+    return nullptr;
+  }
+  return std::unique_ptr<PacketRing>(new PacketRing(mem, st.st_size));
+}
+
+int64_t PacketRing::write(std::initializer_list<std::pair<const uint8_t *, size_t>> parts) {
+  size_t len = 0;
+  for (auto &[_, size] : parts) len += size;
+  if (len > data_size / 4) {
+    return -1;
+  }
+
+  // a packet that doesn't fit before the end of the ring starts over at its beginning
+  uint64_t offset = header->write_end.load(std::memory_order_relaxed);
+  if (offset % data_size + len > data_size) {
+    offset += data_size - offset % data_size;
+  }
+
+  // readers have to see the new end before any of the bytes it overwrites
+  header->write_end.store(offset + len, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  uint8_t *dst = data + offset % data_size;
+  for (auto &[src, size] : parts) {
+    memcpy(dst, src, size);
+    dst += size;
+  }
+  return offset;
+}
+
+const uint8_t *PacketRing::read(uint64_t offset, size_t len) const {
+  const uint64_t end = header->write_end.load(std::memory_order_acquire);
+  if (header->size != data_size || offset + len > end || end > offset + data_size) {
+    return nullptr;
+  }
+  return data + offset % data_size;
+}
+
+bool PacketRing::valid(uint64_t offset) const {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return header->write_end.load(std::memory_order_relaxed) <= offset + data_size;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <utility>
+
+// seconds of packets at the encoder's bitrate a ring holds before it's overwritten
+#define PACKET_RING_SECONDS 10
+#define PACKET_RING_MIN_SIZE (1 << 20)
+
+// Shared memory ring of encoded packets, written by one encoderd encoder and read by loggerd, like
+// visionipc does for camera frames. Only the small EncodeData messages go over msgq, they hold the
+// ring offset of their packet and loggerd copies the packet out of the shared memory.
+//
+// Offsets only grow, a packet is never split across the end of the ring. The writer publishes how
+// far it's about to write before it copies a packet in, so a reader that checks a packet is still
+// intact after copying it knows the copy wasn't overwritten meanwhile.
+class PacketRing {
+public:
+  // the writer creates the ring or takes over the one of a previous encoderd, offsets keep growing
+  static std::unique_ptr<PacketRing> create(const std::string &name, size_t size);
+  // nullptr if the ring doesn't exist yet
+  static std::unique_ptr<PacketRing> open(const std::string &name);
+  ~PacketRing();
+
+  // copies the parts back to back into the ring and returns the offset of the first one, -1 if they
+  // don't fit in a quarter of the ring
+  int64_t write(std::initializer_list<std::pair<const uint8_t *, size_t>> parts);
+
+  // len bytes at offset, nullptr if they were already overwritten
+  const uint8_t *read(uint64_t offset, size_t len) const;
+  // whether the bytes read at offset are still intact, to check after using them
+  bool valid(uint64_t offset) const;
+
+  inline size_t size() const { return data_size; }
+
+private:
+  struct Header {
+    uint64_t size;
+    // end of the bytes the writer is writing or has written
+    std::atomic<uint64_t> write_end;
+  };
+
+  PacketRing(void *mem, size_t mem_size);
+  static std::string path(const std::string &name);
+
+  void *mem;
+  const size_t mem_size;
+  Header *header;
+  uint8_t *data;
+  const size_t data_size;
+};
@@ -0,0 +1,124 @@
+#include "system/loggerd/segment_file.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "common/swaglog.h"
+#include "common/timing.h"
+#include "common/util.h"
+
+SegmentFile::SegmentFile(const std::string &path, size_t preallocate, bool direct)
+    : path(path), direct(direct), limit_writeback(!getenv("LOGGERD_UNBOUNDED_WRITEBACK")) {
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#ifdef __linux__
+  if (direct) {
+    fd = HANDLE_EINTR(open(path.c_str(), flags | O_DIRECT, 0664));
+    if (fd < 0 && errno == EINVAL) {
+      LOGW("%s: O_DIRECT not supported, writing through the page cache", path.c_str());
+    }
+  }
+#endif
+  if (fd < 0) {
+    this->direct = false;
+    fd = HANDLE_EINTR(open(path.c_str(), flags, 0664));
+  }
+  if (fd < 0) {
+    LOGE("failed to open %s: %s", path.c_str(), strerror(errno));
+    return;
+  }
+
+#ifdef __linux__
+  // the file size stays at what's written, the blocks after it are reserved
+  if (preallocate > 0 && fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, preallocate) != 0) {
+    LOGD("%s: fallocate failed: %s", path.c_str(), strerror(errno));
+  }
+#endif
+
+  int err = posix_memalign((void **)&buf, SEGMENT_FILE_ALIGN, SEGMENT_FILE_BLOCK_SIZE);
+  assert(err == 0);
+}
+
+SegmentFile::~SegmentFile() {
+  if (fd < 0) return;
+
+#ifdef __linux__
+  // O_DIRECT only writes whole aligned blocks, the tail goes through the page cache
+  if (direct && buffered % SEGMENT_FILE_ALIGN != 0) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+    direct = false;
+  }
+#endif
+  if (buffered > 0 && !writeOut(buffered)) {
+    LOGE("failed to write %s: %s", path.c_str(), strerror(errno));
+  }
+
+  // release the preallocated blocks that weren't used
+  if (ftruncate(fd, written) != 0) {
+    LOGE("failed to truncate %s: %s", path.c_str(), strerror(errno));
+  }
+  close(fd);
+  free(buf);
+  LOGD("%s: %zu bytes, max writeback wait %.1fms", path.c_str(), written, maxWritebackWaitMs());
+}
+
+bool SegmentFile::write(const void *data, size_t size) {
+  if (fd < 0) return false;
+
+  const uint8_t *src = (const uint8_t *)data;
+  while (size > 0) {
+    const size_t n = std::min(size, SEGMENT_FILE_BLOCK_SIZE - buffered);
+    memcpy(buf + buffered, src, n);
+    buffered += n;
+    src += n;
+    size -= n;
+    if (buffered == SEGMENT_FILE_BLOCK_SIZE && !writeOut(buffered)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SegmentFile::flush() {
+  if (fd < 0) return false;
+
+  // O_DIRECT writes keep the file offset aligned
+  const size_t size = direct ? buffered - buffered % SEGMENT_FILE_ALIGN : buffered;
+  return size == 0 || writeOut(size);
+}
+
+// writes the first size bytes of the buffer, the rest moves to its start
+bool SegmentFile::writeOut(size_t size) {
+  for (size_t pos = 0; pos < size; ) {
+    ssize_t ret = HANDLE_EINTR(::write(fd, buf + pos, size - pos));
+    if (ret <= 0) return false;
+    pos += ret;
+  }
+
+#ifdef __linux__
+  if (!direct && limit_writeback) {
+    // start writing back what was just written, without waiting for it. By the time the block before
+    // the previous one is dropped from the page cache its writeback is done, pages still under
+    // writeback are skipped
+    const uint64_t start = nanos_since_boot();
+    sync_file_range(fd, written, size, SYNC_FILE_RANGE_WRITE);
+    max_wait_ns = std::max(max_wait_ns, nanos_since_boot() - start);
+    const size_t end = written + size;
+    if (end >= dropped + 3 * SEGMENT_FILE_BLOCK_SIZE) {
+      const size_t drop_end = end - 2 * SEGMENT_FILE_BLOCK_SIZE;
+      posix_fadvise(fd, dropped, drop_end - dropped, POSIX_FADV_DONTNEED);
+      dropped = drop_end;
+    }
+  }
+#endif
+
+  written += size;
+  buffered -= size;
+  memmove(buf, buf + size, buffered);
+  return true;
+}
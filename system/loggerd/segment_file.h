@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// writes go to the file in blocks of this size, aligned for O_DIRECT
+#define SEGMENT_FILE_BLOCK_SIZE (1024 * 1024)
+#define SEGMENT_FILE_ALIGN 4096
+
+// A segment file written sequentially in large aligned blocks, without letting dirty pages pile up.
+//
+// The file is preallocated to its expected size so it doesn't fragment as it grows, the unused rest
+// is released on close. Once data is written its writeback is started right away, without waiting
+// for it, and the blocks written before the previous one are dropped from the page cache, so the
+// kernel doesn't pile up seconds of dirty data and flush it at once, which stalls the other processes
+// writing to the same disk. With direct the page cache is bypassed altogether, where the filesystem
+// supports O_DIRECT.
+//
+// flush() writes out what's buffered of the current block, so a crash loses less than a whole block.
+class SegmentFile {
+public:
+  SegmentFile(const std::string &path, size_t preallocate = 0, bool direct = false);
+  ~SegmentFile();
+  bool write(const void *data, size_t size);
+  // with direct, the part that isn't a multiple of SEGMENT_FILE_ALIGN stays buffered
+  bool flush();
+
+  inline bool is_open() const { return fd >= 0; }
+  // false if O_DIRECT isn't supported
+  inline bool is_direct() const { return direct; }
+  inline size_t size() const { return written + buffered; }
+  // longest a write took to start the writeback
+  inline double maxWritebackWaitMs() const { return max_wait_ns / 1e6; }
+
+private:
+  bool writeOut(size_t size);
+
+  const std::string path;
+  int fd = -1;
+  bool direct;
+  // global switch to leave the writeback to the kernel, for comparisons
+  const bool limit_writeback;
+
+  uint8_t *buf = nullptr;
+  size_t buffered = 0;
+  size_t written = 0;
+  size_t dropped = 0;  // from the page cache, up to here
+  uint64_t max_wait_ns = 0;
+};
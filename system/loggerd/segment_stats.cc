@@ -0,0 +1,102 @@
+#include "system/loggerd/segment_stats.h"
+
+#include <capnp/schema.h>
+
+#include "third_party/json11/json11.hpp"
+
+// names of the Event union's fields by discriminant
+static const std::vector<std::string> &event_names() {
+  static const std::vector<std::string> names = [] {
+    auto event_struct = capnp::Schema::from<cereal::Event>().asStruct();
+    std::vector<std::string> ret(event_struct.getUnionFields().size());
+    for (auto field : event_struct.getUnionFields()) {
+      ret[field.getProto().getDiscriminantValue()] = field.getProto().getName().cStr();
+    }
+    return ret;
+  }();
+  return names;
+}
+
+SegmentStats::SegmentStats() : counts(event_names().size()), bytes(event_names().size()) {}
+
+void SegmentStats::update(const cereal::Event::Reader &event, size_t size) {
+  const uint64_t mono_time = event.getLogMonoTime();
+  if (total_count++ == 0) start_time = mono_time;
+  end_time = std::max(end_time, mono_time);
+
+  const uint16_t which = event.which();
+  if (which < counts.size()) {
+    ++counts[which];
+    bytes[which] += size;
+  }
+
+  switch (which) {
+    case cereal::Event::CAR_STATE: {
+      auto cs = event.getCarState();
+      v_ego.add(cs.getVEgo());
+      a_ego.add(cs.getAEgo());
+      steering_angle.add(cs.getSteeringAngleDeg());
+      break;
+    }
+    case cereal::Event::CONTROLS_STATE: {
+      auto cs = event.getControlsState();
+      if (!controls_seen) {
+        // the state a segment starts in carries over from the previous one, it's not a transition
+        controls_seen = true;
+        engaged = cs.getEnabled();
+      } else {
+        if (engaged && mono_time > last_controls_time) {
+          engaged_ns += mono_time - last_controls_time;
+        }
+        if (cs.getEnabled() != engaged) {
+          ++(cs.getEnabled() ? engagements : disengagements);
+          engaged = cs.getEnabled();
+        }
+      }
+      last_controls_time = mono_time;
+
+      // count every alert when it comes up, not every message it's shown in
+      auto alert_type = cs.getAlertType();
+      if (alert != alert_type.cStr()) {
+        alert = alert_type.cStr();
+        if (!alert.empty()) ++alerts[alert];
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+std::string SegmentStats::toJson() const {
+  json11::Json::object services;
+  for (int i = 0; i < counts.size(); ++i) {
+    if (counts[i] > 0) {
+      services[event_names()[i]] = json11::Json::object{{"count", (double)counts[i]}, {"bytes", (double)bytes[i]}};
+    }
+  }
+
+  auto signal = [](const Signal &s) -> json11::Json {
+    if (s.count == 0) return nullptr;
+    return json11::Json::object{{"min", s.min}, {"max", s.max}, {"mean", s.sum / s.count}, {"count", (double)s.count}};
+  };
+
+  json11::Json::object alert_counts;
+  for (auto &[type, count] : alerts) alert_counts[type] = (double)count;
+
+  return json11::Json(json11::Json::object{
+    {"monoTimeStart", start_time / 1e9},
+    {"monoTimeEnd", end_time / 1e9},
+    {"messages", (double)total_count},
+    {"services", services},
+    {"signals", json11::Json::object{
+      {"vEgo", signal(v_ego)},
+      {"aEgo", signal(a_ego)},
+      {"steeringAngleDeg", signal(steering_angle)},
+    }},
+    {"engagedSeconds", engaged_ns / 1e9},
+    {"engagements", (double)engagements},
+    {"disengagements", (double)disengagements},
+    {"alerts", alert_counts},
+  }).dump();
+}
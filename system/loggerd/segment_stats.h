@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cereal/gen/cpp/log.capnp.h"
+
+// Summary of a segment's messages: the count and size of every service, a few key signals, the
+// engaged time and the alerts. It's built from the events loggerd already parsed for the log index,
+// so fleet tooling can answer most queries from the small stats.json next to the logs instead of
+// downloading and decompressing the rlog.
+class SegmentStats {
+public:
+  SegmentStats();
+  void update(const cereal::Event::Reader &event, size_t size);
+  std::string toJson() const;
+  inline uint64_t messages() const { return total_count; }
+
+private:
+  struct Signal {
+    void add(double v) {
+      min = std::min(min, v);
+      max = std::max(max, v);
+      sum += v;
+      ++count;
+    }
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double sum = 0;
+    uint64_t count = 0;
+  };
+
+  // by the Event union's discriminant
+  std::vector<uint32_t> counts;
+  std::vector<uint64_t> bytes;
+  uint64_t total_count = 0;
+  uint64_t start_time = 0, end_time = 0;
+
+  Signal v_ego, a_ego, steering_angle;
+
+  bool controls_seen = false;
+  uint64_t last_controls_time = 0;
+  bool engaged = false;
+  uint64_t engaged_ns = 0;
+  uint32_t engagements = 0, disengagements = 0;
+
+  std::string alert;
+  std::map<std::string, uint32_t> alerts;  // how often each alert type came up
+};
@@ -0,0 +1,211 @@
+#!/usr/bin/env python3
+"""Measure the load loggerd sustains: synthetic publishers for every logged service plus fake encoder streams.
+
+  system/loggerd/tests/benchmark_loggerd.py --mult 4 --duration 30 --segment 5
+
+Every logged service is published at --mult times its services.py frequency, the encoder streams at camera fps
+with the bitrate of the real encoders. The encoder segment number advances every --segment seconds, which is
+what makes loggerd rotate. Logs go to a tmpfs by default, pass --log-root to measure a real disk.
+
+Drops are the messages sent but missing from the logs, either because loggerd's reader was lapped in msgq or
+because it wasn't drained before the end. The rotation latency is the time from the first packet of a new
+segment on every encoder stream to the startOfSegment sentinel.
+
+The fsync latency is measured by another writer on the same disk, writing and fsyncing a small file every
+--fsync-interval seconds, like the other processes on the device that loggerd's writeback stalls. Compare
+runs with --unbounded-writeback, which leaves the writeback of the segment files to the kernel, and
+--direct-io, which writes the video files with O_DIRECT.
+"""
+import argparse
+import os
+import shutil
+import signal
+import subprocess
+import tempfile
+import threading
+import time
+from collections import Counter
+from pathlib import Path
+
+import numpy as np
+import psutil
+
+import cereal.messaging as messaging
+from cereal import log
+from cereal.services import SERVICE_LIST
+from openpilot.common.basedir import BASEDIR
+from openpilot.tools.lib.logreader import LogReader
+
+CAMERA_FPS = 20
+ENCODERS = {
+  # service: (encode type, bitrate)
+  "roadEncodeData": (log.EncodeIndex.Type.fullHEVC, 10e6),
+  "wideRoadEncodeData": (log.EncodeIndex.Type.fullHEVC, 10e6),
+  "driverEncodeData": (log.EncodeIndex.Type.fullHEVC, 10e6),
+  "qRoadEncodeData": (log.EncodeIndex.Type.qcameraH264, 256e3),
+}
+SERVICES = [s for s in log.Event.schema.union_fields if s in SERVICE_LIST
+            and SERVICE_LIST[s].should_log and "encode" not in s.lower()]
+V4L2_BUF_FLAG_KEYFRAME = 8
+ANNEXB_START = b"\x00\x00\x00\x01"
+
+
+def boot_ns() -> int:
+  # the clock of nanos_since_boot(), which stamps the sentinels
+  return time.clock_gettime_ns(time.CLOCK_BOOTTIME)
+
+
+def service_message(s: str) -> bytes:
+  try:
+    m = messaging.new_message(s)
+  except Exception:
+    m = messaging.new_message(s, 10)
+  return m.to_bytes()
+
+
+def encode_message(s: str, frame_id: int, segment: int, segment_frames: int) -> bytes:
+  encode_type, bitrate = ENCODERS[s]
+  m = messaging.new_message(s, logMonoTime=boot_ns())
+  dat = getattr(m, s)
+  keyframe = frame_id % segment_frames == 0
+  dat.idx.frameId = frame_id
+  dat.idx.encodeId = frame_id
+  dat.idx.type = encode_type
+  dat.idx.segmentNum = segment
+  dat.idx.segmentId = frame_id % segment_frames
+  dat.idx.flags = V4L2_BUF_FLAG_KEYFRAME if keyframe else 0
+  dat.idx.timestampSof = dat.idx.timestampEof = m.logMonoTime
+  dat.width, dat.height = (526, 330) if encode_type == log.EncodeIndex.Type.qcameraH264 else (1928, 1208)
+  # start codes, so the mpegts muxer of qcamera.ts takes them
+  dat.header = ANNEXB_START + os.urandom(28)
+  dat.data = ANNEXB_START + os.urandom(int(bitrate / 8 / CAMERA_FPS) * (4 if keyframe else 1))
+  return m.to_bytes()
+
+
+def fsync_probe(path: str, interval: float, stop: threading.Event, latencies: list[float]) -> None:
+  with open(path, "wb") as f:
+    while not stop.wait(interval):
+      st = time.monotonic()
+      f.write(os.urandom(4096))
+      f.flush()
+      os.fsync(f.fileno())
+      latencies.append((time.monotonic() - st) * 1e3)
+  os.unlink(path)
+
+
+def run(args, log_root: str) -> dict:
+  env = os.environ.copy()
+  env.update({
+    "LOG_ROOT": log_root,
+    "LOGGERD_TEST": "1",
+    "LOGGERD_SEGMENT_LENGTH": str(args.segment),
+  })
+  if args.direct_io:
+    env["LOGGERD_DIRECT_IO"] = "1"
+  if args.unbounded_writeback:
+    env["LOGGERD_UNBOUNDED_WRITEBACK"] = "1"
+
+  pm = messaging.PubMaster(SERVICES + list(ENCODERS))
+  dat = {s: service_message(s) for s in SERVICES}
+  freq = {s: max(SERVICE_LIST[s].frequency, 1.) * args.mult for s in SERVICES}
+  sent, sent_bytes = Counter(), 0
+  segment_frames = int(args.segment * CAMERA_FPS)
+  rotate_sent = {}
+
+  proc = subprocess.Popen(["./loggerd"], cwd=os.path.join(BASEDIR, "system/loggerd"), env=env)
+  try:
+    for s in SERVICES + list(ENCODERS):
+      assert pm.wait_for_readers_to_update(s, timeout=5), f"loggerd didn't subscribe to {s}"
+
+    fsync_ms: list[float] = []
+    stop_probe = threading.Event()
+    probe = threading.Thread(target=fsync_probe, args=(os.path.join(log_root, "fsync_probe"), args.fsync_interval, stop_probe, fsync_ms),
+                             daemon=True)
+    probe.start()
+
+    p = psutil.Process(proc.pid)
+    cpu_start = sum(p.cpu_times()[:2])
+    st = time.monotonic()
+    frame_id = 0
+    while (dt := time.monotonic() - st) < args.duration:
+      assert proc.poll() is None, "loggerd exited"
+      for s in SERVICES:
+        for _ in range(int(dt * freq[s]) - sent[s]):
+          pm.send(s, dat[s])
+          sent[s] += 1
+          sent_bytes += len(dat[s])
+
+      while frame_id < dt * CAMERA_FPS:
+        segment = frame_id // segment_frames
+        for s in ENCODERS:
+          msg = encode_message(s, frame_id, segment, segment_frames)
+          pm.send(s, msg)
+          sent[s] += 1
+          sent_bytes += len(msg)
+        if frame_id % segment_frames == 0:
+          rotate_sent[segment] = boot_ns()
+        frame_id += 1
+      time.sleep(0.001)
+
+    dt = time.monotonic() - st
+    for s in SERVICES + list(ENCODERS):
+      pm.wait_for_readers_to_update(s, timeout=5)
+    cpu = sum(p.cpu_times()[:2]) - cpu_start
+    stop_probe.set()
+    probe.join()
+  finally:
+    proc.send_signal(signal.SIGINT)
+    proc.wait(timeout=30)
+
+  # count what made it into the logs
+  logged = Counter()
+  rotate_ms = []
+  segments = sorted(Path(log_root).glob("*--*"), key=lambda p: int(p.name.rsplit("--", 1)[1]))
+  for seg in segments:
+    n = int(seg.name.rsplit("--", 1)[1])
+    if not (seg / "rlog.zst").exists():
+      continue
+    for m in LogReader(str(seg / "rlog.zst")):
+      w = m.which()
+      logged[w] += 1
+      if w == "sentinel" and m.sentinel.type == log.Sentinel.SentinelType.startOfSegment and n in rotate_sent:
+        rotate_ms.append((m.logMonoTime - rotate_sent[n]) / 1e6)
+  disk_bytes = sum(f.stat().st_size for seg in segments for f in seg.iterdir() if f.is_file())
+
+  drops = {s: sent[s] - logged[s.replace("EncodeData", "EncodeIdx")] for s in sent}
+  ret = {
+    "segments": len(segments),
+    "sent msgs/s": sum(sent.values()) / dt,
+    "sent MB/s": sent_bytes / dt / 1e6,
+    "written MB/s": disk_bytes / dt / 1e6,
+    "dropped msgs": sum(max(d, 0) for d in drops.values()),
+    "cpu %": cpu / dt * 100,
+    "rotation p50 ms": np.percentile(rotate_ms, 50) if rotate_ms else float('nan'),
+    "rotation max ms": max(rotate_ms) if rotate_ms else float('nan'),
+    "fsync p50 ms": np.percentile(fsync_ms, 50) if fsync_ms else float('nan'),
+    "fsync p99 ms": np.percentile(fsync_ms, 99) if fsync_ms else float('nan'),
+    "fsync max ms": max(fsync_ms) if fsync_ms else float('nan'),
+  }
+  for s, d in sorted(drops.items(), key=lambda x: -x[1]):
+    if d > 0:
+      ret[f"drops {s}"] = f"{d}/{sent[s]}"
+  return ret
+
+
+if __name__ == "__main__":
+  parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument("--mult", type=float, default=1, help="multiple of every service's frequency")
+  parser.add_argument("--segment", type=int, default=5, help="segment length in seconds")
+  parser.add_argument("--duration", type=float, default=20)
+  parser.add_argument("--log-root", help="log on this disk instead of a tmpfs")
+  parser.add_argument("--fsync-interval", type=float, default=0.05)
+  parser.add_argument("--direct-io", action="store_true", help="LOGGERD_DIRECT_IO")
+  parser.add_argument("--unbounded-writeback", action="store_true", help="LOGGERD_UNBOUNDED_WRITEBACK")
+  args = parser.parse_args()
+
+  log_root = tempfile.mkdtemp(dir=args.log_root or ("/dev/shm" if os.path.isdir("/dev/shm") else None))
+  try:
+    for k, v in run(args, log_root).items():
+      print(f"{k:>32}: {v:.2f}" if isinstance(v, float) else f"{k:>32}: {v}")
+  finally:
+    shutil.rmtree(log_root)
@@ -1,17 +1,50 @@
 #include "catch2/catch.hpp"
 #include "system/loggerd/logger.h"
+#include "third_party/json11/json11.hpp"
 
 typedef cereal::Sentinel::SentinelType SentinelType;
 
+std::string decompress_log(const std::string &in) {
+  std::string out;
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  ZSTD_inBuffer input = {in.data(), in.size(), 0};
+  std::string buf(ZSTD_DStreamOutSize(), '\0');
+  while (input.pos < input.size) {
+    ZSTD_outBuffer output = {buf.data(), buf.size(), 0};
+    size_t ret = ZSTD_decompressStream(dctx, &output, &input);
+    REQUIRE(!ZSTD_isError(ret));
+    out.append(buf.data(), output.pos);
+  }
+  ZSTD_freeDCtx(dctx);
+  return out;
+}
+
+// (compressed, decompressed) frame sizes from the seek table at the end of the file
+std::vector<std::pair<uint32_t, uint32_t>> read_seek_table(const std::string &log) {
+  auto u32 = [&](size_t pos) { uint32_t v; memcpy(&v, &log[pos], sizeof(v)); return v; };
+  REQUIRE(log.size() >= 17);
+  REQUIRE(u32(log.size() - 4) == 0x8F92EAB1);
+  const uint32_t num_frames = u32(log.size() - 9);
+  const size_t table_start = log.size() - 9 - num_frames * 8;
+  REQUIRE(u32(table_start - 8) == 0x184D2A5E);
+  REQUIRE(u32(table_start - 4) == num_frames * 8 + 9);
+
+  std::vector<std::pair<uint32_t, uint32_t>> frames;
+  for (int i = 0; i < num_frames; ++i) {
+    frames.emplace_back(u32(table_start + i * 8), u32(table_start + i * 8 + 4));
+  }
+  return frames;
+}
+
 void verify_segment(const std::string &route_path, int segment, int max_segment, int required_event_cnt) {
   const std::string segment_path = route_path + "--" + std::to_string(segment);
   SentinelType begin_sentinel = segment == 0 ? SentinelType::START_OF_ROUTE : SentinelType::START_OF_SEGMENT;
   SentinelType end_sentinel = segment == max_segment - 1 ? SentinelType::END_OF_ROUTE : SentinelType::END_OF_SEGMENT;
 
   REQUIRE(!util::file_exists(segment_path + "/rlog.lock"));
-  for (const char *fn : {"/rlog", "/qlog"}) {
+  for (const char *fn : {"/rlog.zst", "/qlog.zst"}) {
     const std::string log_file = segment_path + fn;
-    std::string log = util::read_file(log_file);
+    std::string log = decompress_log(util::read_file(log_file));
     REQUIRE(!log.empty());
     int event_cnt = 0, i = 0;
     kj::ArrayPtr<const capnp::word> words((capnp::word *)log.data(), log.size() / sizeof(capnp::word));
@@ -63,6 +96,7 @@ TEST_CASE("logger") {
     for (int i = 0; i < segment_cnt; ++i) {
       REQUIRE(logger.next());
       REQUIRE(util::file_exists(logger.segmentPath() + "/rlog.lock"));
+      REQUIRE(util::file_exists(logger.segmentPath() + "/rlog.zst"));
       REQUIRE(logger.segment() == i);
       write_msg(&logger);
     }
@@ -71,4 +105,113 @@ TEST_CASE("logger") {
   for (int i = 0; i < segment_cnt; ++i) {
     verify_segment(log_root + "/" + route_name, i, segment_cnt, 1);
   }
+  // the segment opened ahead of the next rotation is removed
+  REQUIRE(!util::file_exists(log_root + "/" + route_name + "--" + std::to_string(segment_cnt)));
+}
+
+TEST_CASE("logger zstd frames") {
+  const std::string log_root = "/tmp/test_logger_zstd";
+  system(("rm " + log_root + " -rf").c_str());
+  const int msg_cnt = LOG_ZSTD_FRAME_MSGS * 2 + 10;
+  std::string route_name, segment_path;
+  {
+    LoggerState logger(log_root);
+    REQUIRE(logger.next());
+    route_name = logger.routeName();
+    segment_path = logger.segmentPath();
+    for (int i = 0; i < msg_cnt; ++i) {
+      write_msg(&logger);
+    }
+    logger.setExitSignal(1);
+  }
+
+  // every frame in the seek table decompresses on its own
+  const std::string log = util::read_file(segment_path + "/rlog.zst");
+  auto frames = read_seek_table(log);
+  REQUIRE(frames.size() >= 3);
+  size_t pos = 0, total = 0;
+  for (auto &[compressed, decompressed] : frames) {
+    REQUIRE(ZSTD_getFrameContentSize(&log[pos], compressed) == decompressed);
+    std::string out(decompressed, '\0');
+    REQUIRE(ZSTD_decompress(out.data(), out.size(), &log[pos], compressed) == decompressed);
+    pos += compressed;
+    total += decompressed;
+  }
+  REQUIRE(total == decompress_log(log).size());
+
+  // the index has one entry per frame, pointing at the same bytes as the seek table
+  auto index = log_index_parse(util::read_file(segment_path + "/rlog.idx"));
+  REQUIRE(index.size() == frames.size());
+  uint64_t offset = 0;
+  for (int i = 0; i < index.size(); ++i) {
+    REQUIRE(index[i].offset == offset);
+    REQUIRE(index[i].size == frames[i].first);
+    REQUIRE(index[i].decompressed_size == frames[i].second);
+    REQUIRE(index[i].min_mono_time <= index[i].max_mono_time);
+    offset += index[i].size;
+  }
+  REQUIRE(index[1].hasService((uint16_t)cereal::Event::Which::CLOCKS));
+  REQUIRE(!index[1].hasService((uint16_t)cereal::Event::Which::CAN));
+
+  verify_segment(log_root + "/" + route_name, 0, 1, msg_cnt);
+}
+
+TEST_CASE("logger segment stats") {
+  const std::string log_root = "/tmp/test_logger_stats";
+  system(("rm " + log_root + " -rf").c_str());
+  setenv("LOGGERD_SEGMENT_STATS", "1", 1);
+  std::string segment_path;
+  {
+    LoggerState logger(log_root);
+    REQUIRE(logger.next());
+    segment_path = logger.segmentPath();
+    for (int i = 0; i < 100; ++i) {
+      MessageBuilder cs;
+      auto car_state = cs.initEvent().initCarState();
+      car_state.setVEgo(i);
+      logger.write(cs.toBytes(), false);
+
+      // engaged from 20 to 60, one alert from 30 to 40
+      MessageBuilder ctrl;
+      auto event = ctrl.initEvent();
+      event.setLogMonoTime(1e9 + i * 1e7);
+      auto controls = event.initControlsState();
+      controls.setEnabled(i >= 20 && i < 60);
+      controls.setAlertType(i >= 30 && i < 40 ? "steerSaturated/warning" : "");
+      logger.write(ctrl.toBytes(), false);
+    }
+  }
+  unsetenv("LOGGERD_SEGMENT_STATS");
+
+  std::string err;
+  auto stats = json11::Json::parse(util::read_file(segment_path + "/stats.json"), err);
+  REQUIRE(err.empty());
+  REQUIRE(stats["services"]["carState"]["count"].int_value() == 100);
+  REQUIRE(stats["services"]["controlsState"]["count"].int_value() == 100);
+  REQUIRE(stats["signals"]["vEgo"]["min"].number_value() == 0);
+  REQUIRE(stats["signals"]["vEgo"]["max"].number_value() == 99);
+  REQUIRE(stats["signals"]["vEgo"]["mean"].number_value() == Approx(49.5));
+  REQUIRE(stats["engagedSeconds"].number_value() == Approx(0.4));
+  REQUIRE(stats["engagements"].int_value() == 1);
+  REQUIRE(stats["disengagements"].int_value() == 1);
+  REQUIRE(stats["alerts"]["steerSaturated/warning"].int_value() == 1);
+}
+
+TEST_CASE("segment stats starting engaged") {
+  // engaged from the segment's first controlsState until 50, only the disengagement is counted
+  SegmentStats stats;
+  for (int i = 0; i < 100; ++i) {
+    MessageBuilder msg;
+    auto event = msg.initEvent();
+    event.setLogMonoTime(1e9 + i * 1e7);
+    event.initControlsState().setEnabled(i < 50);
+    stats.update(event.asReader(), 0);
+  }
+
+  std::string err;
+  auto json = json11::Json::parse(stats.toJson(), err);
+  REQUIRE(err.empty());
+  REQUIRE(json["engagedSeconds"].number_value() == Approx(0.5));
+  REQUIRE(json["engagements"].int_value() == 0);
+  REQUIRE(json["disengagements"].int_value() == 1);
 }
@@ -0,0 +1,69 @@
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "system/loggerd/packet_ring.h"
+
+TEST_CASE("PacketRing") {
+  const std::string name = "test_" + std::to_string(getpid());
+  const size_t size = 4096;
+  auto writer = PacketRing::create(name, size);
+  REQUIRE(writer);
+  auto reader = PacketRing::open(name);
+  REQUIRE(reader);
+  REQUIRE(reader->size() == size);
+
+  std::string header = "header", packet(1000, '\0');
+  auto write_packet = [&](int i, bool with_header) {
+    std::fill(packet.begin(), packet.end(), 'a' + i % 26);
+    return writer->write({{(const uint8_t *)header.data(), with_header ? header.size() : 0},
+                          {(const uint8_t *)packet.data(), packet.size()}});
+  };
+
+  SECTION("packets are read back until they are overwritten") {
+    std::vector<int64_t> offsets;
+    for (int i = 0; i < 10; ++i) {
+      offsets.push_back(write_packet(i, i == 0));
+      REQUIRE(offsets.back() >= 0);
+
+      const size_t len = (i == 0 ? header.size() : 0) + packet.size();
+      const uint8_t *p = reader->read(offsets.back(), len);
+      REQUIRE(p != nullptr);
+      REQUIRE(std::string((const char *)p, len).substr(len - packet.size()) == packet);
+      REQUIRE(reader->valid(offsets.back()));
+    }
+
+    // packets never wrap around the end of the ring
+    for (int i = 0; i < offsets.size(); ++i) {
+      REQUIRE(offsets[i] % size + packet.size() <= size);
+    }
+
+    // only the last few fit in the ring
+    REQUIRE(reader->read(offsets[0], header.size() + packet.size()) == nullptr);
+    REQUIRE(!reader->valid(offsets[0]));
+    REQUIRE(reader->read(offsets.back(), packet.size()) != nullptr);
+  }
+
+  SECTION("a packet used while it's overwritten is invalid") {
+    const int64_t offset = write_packet(0, false);
+    REQUIRE(reader->read(offset, packet.size()) != nullptr);
+    for (int i = 1; i < 5; ++i) write_packet(i, false);
+    REQUIRE(!reader->valid(offset));
+  }
+
+  SECTION("a packet larger than a quarter of the ring is rejected") {
+    packet.resize(size / 4 + 1);
+    REQUIRE(write_packet(0, false) == -1);
+  }
+
+  SECTION("a new writer continues after the offsets of the previous one") {
+    const int64_t offset = write_packet(0, false);
+    writer = PacketRing::create(name, size);
+    REQUIRE(write_packet(1, false) > offset);
+    REQUIRE(reader->read(offset, packet.size()) != nullptr);
+  }
+
+  unlink(("/dev/shm/packet_ring_" + name).c_str());
+}
@@ -0,0 +1,60 @@
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "catch2/catch.hpp"
+#include "common/util.h"
+#include "system/loggerd/segment_file.h"
+
+TEST_CASE("SegmentFile") {
+  const bool direct = GENERATE(false, true);
+  const size_t size = GENERATE(0, 1000, SEGMENT_FILE_ALIGN, SEGMENT_FILE_BLOCK_SIZE, 3 * SEGMENT_FILE_BLOCK_SIZE + 1234);
+  const std::string path = "/tmp/test_segment_file_" + std::to_string(getpid());
+
+  std::string content(size, '\0');
+  for (size_t i = 0; i < size; ++i) content[i] = (i * 7919) >> 8;
+
+  {
+    SegmentFile file(path, 8 * SEGMENT_FILE_BLOCK_SIZE, direct);
+    REQUIRE(file.is_open());
+    // writes of all sizes, across the block boundaries
+    for (size_t pos = 0, n = 1; pos < size; pos += n, n = n * 3 + 1) {
+      REQUIRE(file.write(content.data() + pos, std::min(n, size - pos)));
+    }
+    REQUIRE(file.size() == size);
+  }
+
+  // the unused preallocation is released
+  struct stat st = {};
+  REQUIRE(stat(path.c_str(), &st) == 0);
+  REQUIRE(st.st_size == size);
+  REQUIRE(st.st_blocks * 512 < size + 2 * SEGMENT_FILE_BLOCK_SIZE);
+  REQUIRE(util::read_file(path) == content);
+  unlink(path.c_str());
+}
+
+TEST_CASE("SegmentFile flush") {
+  const bool direct = GENERATE(false, true);
+  const std::string path = "/tmp/test_segment_file_flush_" + std::to_string(getpid());
+
+  std::string content(SEGMENT_FILE_BLOCK_SIZE + 3 * SEGMENT_FILE_ALIGN + 100, '\0');
+  for (size_t i = 0; i < content.size(); ++i) content[i] = (i * 7919) >> 8;
+
+  {
+    SegmentFile file(path, 0, direct);
+    REQUIRE(file.is_open());
+    size_t pos = 0;
+    for (size_t n : {size_t(100), size_t(SEGMENT_FILE_ALIGN), content.size() - 100 - SEGMENT_FILE_ALIGN}) {
+      REQUIRE(file.write(content.data() + pos, n));
+      REQUIRE(file.flush());
+      pos += n;
+      // what's buffered reaches the file, with direct only whole aligned blocks
+      const size_t on_disk = file.is_direct() ? pos - pos % SEGMENT_FILE_ALIGN : pos;
+      REQUIRE(util::read_file(path) == content.substr(0, on_disk));
+    }
+    REQUIRE(file.size() == content.size());
+  }
+  REQUIRE(util::read_file(path) == content);
+  unlink(path.c_str());
+}
@@ -86,6 +86,31 @@ class TestUploader(UploaderTestCase):
 
     assert log_handler.upload_order == exp_order, "Files uploaded in wrong order"
 
+  def test_upload_zst(self):
+    for t in ["qlog.zst", "rlog.zst"]:
+      self.make_file_with_data(self.seg_dir, t, 1)
+
+    self.start_thread()
+    time.sleep(5)
+    self.join_thread()
+
+    # zstd logs are already compressed, they're uploaded under their own name
+    assert log_handler.upload_order == [f"{self.seg_format.format(self.seg_num)}/qlog.zst"]
+
+  def test_no_upload_empty_zst(self):
+    # the segment loggerd opened ahead of a crash
+    for t in ["qlog.zst", "rlog.zst"]:
+      self.make_file_with_data(self.seg_dir, t, 0)
+
+    self.start_thread()
+    time.sleep(5)
+    self.join_thread()
+
+    assert len(log_handler.upload_order) == 0, "Empty log uploaded"
+    for t in ["qlog.zst", "rlog.zst"]:
+      fn = Path(Paths.log_root()) / self.seg_dir / t
+      assert UPLOAD_ATTR_NAME not in os.listxattr(fn)
+
   def test_upload_with_wrong_xattr(self):
     self.gen_files(lock=False, xattr=b'0')
 
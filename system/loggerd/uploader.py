@@ -30,6 +30,7 @@ UPLOAD_ATTR_VALUE = b'1'
 MAX_UPLOAD_SIZES = {
   "qlog": 25*1e6,  # can't be too restrictive here since we use qlogs to find
                    # bugs, including ones that can cause massive log sizes
+  "qlog.zst": 25*1e6,
   "qcam": 5*1e6,
 }
 
@@ -89,7 +90,7 @@ class Uploader:
     self.last_filename = ""
 
     self.immediate_folders = ["crash/", "boot/"]
-    self.immediate_priority = {"qlog": 0, "qlog.bz2": 0, "qcamera.ts": 1}
+    self.immediate_priority = {"stats.json": 0, "qlog": 0, "qlog.bz2": 0, "qlog.zst": 0, "qcamera.ts": 1}
 
   def list_upload_files(self, metered: bool) -> Iterator[tuple[str, str, str]]:
     r = self.params.get("AthenadRecentlyViewedRoutes", encoding="utf8")
@@ -119,6 +120,13 @@ class Uploader:
         if is_uploaded:
           continue
 
+        # loggerd opens the next segment ahead, if it's killed that one is left behind with empty logs
+        try:
+          if name in ("rlog.zst", "qlog.zst") and os.path.getsize(fn) == 0:
+            continue
+        except OSError:
+          continue
+
         # limit uploading on metered connections
         if metered:
           dt = datetime.timedelta(hours=12)
@@ -223,7 +231,7 @@ class Uploader:
 
     name, key, fn = d
 
-    # qlogs and bootlogs need to be compressed before uploading
+    # uncompressed qlogs and bootlogs need to be compressed before uploading, zstd logs are uploaded as is
     if key.endswith(('qlog', 'rlog')) or (key.startswith('boot/') and not key.endswith('.bz2')):
       key += ".bz2"
 
@@ -5,7 +5,8 @@
 #include "common/swaglog.h"
 #include "common/util.h"
 
-VideoWriter::VideoWriter(const char *path, const char *filename, bool remuxing, int width, int height, int fps, cereal::EncodeIndex::Type codec)
+VideoWriter::VideoWriter(const char *path, const char *filename, bool remuxing, int width, int height, int fps, cereal::EncodeIndex::Type codec,
+                         size_t expected_size, bool direct_io)
   : remuxing(remuxing) {
   vid_path = util::string_format("%s/%s", path, filename);
   lock_path = util::string_format("%s/%s.lock", path, filename);
@@ -45,15 +46,15 @@ VideoWriter::VideoWriter(const char *path, const char *filename, bool remuxing,
     assert(err >= 0);
 
   } else {
-    this->of = util::safe_fopen(this->vid_path.c_str(), "wb");
-    assert(this->of);
+    this->file = std::make_unique<SegmentFile>(this->vid_path, expected_size, direct_io);
+    assert(this->file->is_open());
   }
 }
 
 void VideoWriter::write(uint8_t *data, int len, long long timestamp, bool codecconfig, bool keyframe) {
-  if (of && data) {
-    size_t written = util::safe_fwrite(data, 1, len, of);
-    if (written != len) {
+  if (file && data) {
+    // written out at every keyframe, a crash loses at most the last GOP
+    if (!file->write(data, len) || (keyframe && !file->flush())) {
       LOGE("failed to write file.errno=%d", errno);
     }
   }
@@ -104,9 +105,7 @@ VideoWriter::~VideoWriter() {
     if (err != 0) LOGE("avio_closep failed %d", err);
     avformat_free_context(this->ofmt_ctx);
   } else {
-    util::safe_fflush(this->of);
-    fclose(this->of);
-    this->of = nullptr;
+    this->file.reset();
   }
   unlink(this->lock_path.c_str());
 }
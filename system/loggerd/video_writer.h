@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 
 extern "C" {
@@ -8,15 +9,18 @@ extern "C" {
 }
 
 #include "cereal/messaging/messaging.h"
+#include "system/loggerd/segment_file.h"
 
 class VideoWriter {
 public:
-  VideoWriter(const char *path, const char *filename, bool remuxing, int width, int height, int fps, cereal::EncodeIndex::Type codec);
+  // raw streams are written with a SegmentFile preallocated to the expected size
+  VideoWriter(const char *path, const char *filename, bool remuxing, int width, int height, int fps, cereal::EncodeIndex::Type codec,
+              size_t expected_size = 0, bool direct_io = false);
   void write(uint8_t *data, int len, long long timestamp, bool codecconfig, bool keyframe);
   ~VideoWriter();
 private:
   std::string vid_path, lock_path;
-  FILE *of = nullptr;
+  std::unique_ptr<SegmentFile> file;
 
   AVCodecContext *codec_ctx;
   AVFormatContext *ofmt_ctx;
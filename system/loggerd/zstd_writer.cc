@@ -0,0 +1,132 @@
+#include "system/loggerd/zstd_writer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "common/swaglog.h"
+#include "common/timing.h"
+#include "common/util.h"
+
+// zstd seekable format, see contrib/seekable_format/zstd_seekable_compression_format.md in zstd
+const uint32_t ZSTD_SKIPPABLE_MAGIC = 0x184D2A5E;
+const uint32_t ZSTD_SEEKABLE_MAGIC = 0x8F92EAB1;
+
+ZstdFileWriter::ZstdFileWriter(const std::string &filename, int compression_level, size_t buffer_size, const std::string &index_filename)
+    : file(filename), index_filename(index_filename), compression_level(compression_level), buffer_size(buffer_size) {
+  assert(file.is_open());
+
+  for (int i = 0; i < 2; ++i) {
+    auto buf = std::make_shared<std::string>();
+    buf->reserve(buffer_size);
+    free_buffers.push(buf);
+  }
+  buffers = 2;
+  thread = std::thread(&ZstdFileWriter::writerThread, this);
+}
+
+ZstdFileWriter::~ZstdFileWriter() {
+  closeFrame();
+  frames.push({});
+  thread.join();
+
+  writeSeekTable();
+
+  if (!index_filename.empty()) {
+    const std::string idx = log_index_serialize(index);
+    if (util::write_file(index_filename.c_str(), idx.data(), idx.size(), O_WRONLY | O_CREAT | O_TRUNC) != 0) {
+      LOGE("failed to write log index %s", index_filename.c_str());
+    }
+  }
+}
+
+void ZstdFileWriter::write(void *data, size_t size, uint64_t mono_time, uint16_t which) {
+  if (frame.data && frame.data->size() + size > buffer_size) {
+    closeFrame();
+  }
+  if (!frame.data) {
+    if (!free_buffers.try_pop(frame.data)) {
+      frame.data = std::make_shared<std::string>();
+      frame.data->reserve(std::max(buffer_size, size));
+      buffers++;
+    }
+    frame.entry = {};
+    frame_start = nanos_since_boot();
+  }
+  frame.data->append((const char *)data, size);
+  frame.entry.add(mono_time, which);
+
+  const size_t pending = pending_bytes + frame.data->size();
+  if (pending > high_water_bytes) {
+    high_water_bytes = pending;
+    high_water_buffers = buffers - free_buffers.size();
+  }
+
+  if (++frame_msgs >= LOG_ZSTD_FRAME_MSGS || nanos_since_boot() - frame_start >= LOG_ZSTD_FRAME_NS) {
+    closeFrame();
+  }
+}
+
+void ZstdFileWriter::closeFrame() {
+  if (frame.data) {
+    pending_bytes += frame.data->size();
+    frames.push(frame);
+    frame = {};
+    frame_msgs = 0;
+  }
+}
+
+void ZstdFileWriter::writerThread() {
+  util::set_thread_name("loggerd_zstd");
+
+  ZSTD_CCtx *cctx = ZSTD_createCCtx();
+  assert(cctx != nullptr);
+  ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, compression_level);
+  ZSTD_CCtx_setParameter(cctx, ZSTD_c_contentSizeFlag, 1);
+
+  std::string out;
+  uint64_t offset = 0;
+  for (Frame f = frames.pop(); f.data; f = frames.pop()) {
+    std::string *in = f.data.get();
+    out.resize(ZSTD_compressBound(in->size()));
+    size_t size = ZSTD_compress2(cctx, out.data(), out.size(), in->data(), in->size());
+    assert(!ZSTD_isError(size));
+
+    // every frame goes to the file once it's compressed, a crash only loses the frames in flight
+    bool ret = file.write(out.data(), size) && file.flush();
+    assert(ret);
+    f.entry.offset = offset;
+    f.entry.size = size;
+    f.entry.decompressed_size = in->size();
+    index.push_back(f.entry);
+    offset += size;
+
+    if (size_t backlog = frames.size(); backlog > 1) {
+      LOGW("zstd writer is %zu frames behind", backlog);
+    }
+    pending_bytes -= in->size();
+    in->clear();
+    free_buffers.push(f.data);
+  }
+  ZSTD_freeCCtx(cctx);
+}
+
+void ZstdFileWriter::writeSeekTable() {
+  std::vector<uint32_t> table = {ZSTD_SKIPPABLE_MAGIC, 0};
+  for (const auto &e : index) {
+    table.push_back(e.size);
+    table.push_back(e.decompressed_size);
+  }
+  table.push_back(index.size());
+
+  // footer: frame count, descriptor byte (no checksums) and the seekable magic
+  std::string buf((const char *)table.data(), table.size() * sizeof(uint32_t));
+  buf.push_back(0);
+  buf.append((const char *)&ZSTD_SEEKABLE_MAGIC, sizeof(ZSTD_SEEKABLE_MAGIC));
+
+  const uint32_t frame_size = buf.size() - 2 * sizeof(uint32_t);
+  memcpy(&buf[sizeof(uint32_t)], &frame_size, sizeof(frame_size));
+
+  bool ret = file.write(buf.data(), buf.size());
+  assert(ret);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <zstd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <capnp/common.h>
+
+#include "common/queue.h"
+#include "system/loggerd/log_index.h"
+#include "system/loggerd/segment_file.h"
+
+// a frame is closed after this many messages or this much time, whichever comes first
+const size_t LOG_ZSTD_FRAME_MSGS = 10000;
+const uint64_t LOG_ZSTD_FRAME_NS = 1e9;
+
+// Compresses a log file on its own writer thread. Every frame is an independent zstd frame, and the
+// file ends with a seek table in the zstd seekable format, so a reader can start decompressing at
+// any frame. Regular zstd decoders skip the seek table.
+//
+// Messages are collected in one of two preallocated buffers while the writer thread compresses the
+// other one. A frame is also closed before it outgrows its buffer. Only if the writer falls behind
+// further is another buffer allocated, writes never wait for the writer thread.
+class ZstdFileWriter {
+public:
+  ZstdFileWriter(const std::string &filename, int compression_level, size_t buffer_size, const std::string &index_filename = "");
+  ~ZstdFileWriter();
+  // an event, with its logMonoTime and which for the index
+  void write(void *data, size_t size, uint64_t mono_time, uint16_t which);
+
+  // most bytes waiting to be compressed at once, and the number of buffers in use at that time
+  inline size_t highWaterBytes() const { return high_water_bytes; }
+  inline size_t highWaterBuffers() const { return high_water_buffers; }
+
+private:
+  struct Frame {
+    std::shared_ptr<std::string> data;
+    LogIndexEntry entry;
+  };
+
+  void closeFrame();
+  void writerThread();
+  void writeSeekTable();
+
+  SegmentFile file;
+  const std::string index_filename;
+  const int compression_level;
+  const size_t buffer_size;
+
+  Frame frame;
+  size_t frame_msgs = 0;
+  uint64_t frame_start = 0;
+
+  // closed frames waiting to be compressed, a frame without data stops the writer thread
+  SafeQueue<Frame> frames;
+  // compressed frames' buffers, reused for new frames
+  SafeQueue<std::shared_ptr<std::string>> free_buffers;
+  size_t buffers = 0;
+  std::atomic<size_t> pending_bytes = 0;
+  size_t high_water_bytes = 0, high_water_buffers = 0;
+
+  // every frame written, for the seek table and the index
+  std::vector<LogIndexEntry> index;
+  std::thread thread;
+};
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <limits>
+#include <memory>
 
 #include <QActionGroup>
 #include <QApplication>
@@ -288,15 +289,19 @@ void ChartView::appendCanEvents(const cabana::Signal *sig, const std::vector<con
   vals.reserve(vals.size() + events.capacity());
   step_vals.reserve(step_vals.size() + events.capacity() * 2);
 
-  double value = 0;
+  std::vector<double> values(events.size());
+  std::unique_ptr<bool[]> valid(new bool[events.size()]);
+  sig->getValues(events.data(), events.size(), values.data(), valid.get());
+
   const uint64_t begin_mono_time = can->routeStartTime() * 1e9;
-  for (const CanEvent *e : events) {
-    if (sig->getValue(e->dat, e->size, &value)) {
+  for (size_t i = 0; i < events.size(); ++i) {
+    if (valid[i]) {
+      const CanEvent *e = events[i];
       const double ts = (e->mono_time - std::min(e->mono_time, begin_mono_time)) / 1e9;
-      vals.emplace_back(ts, value);
+      vals.emplace_back(ts, values[i]);
       if (!step_vals.empty())
         step_vals.emplace_back(ts, step_vals.back().y());
-      step_vals.emplace_back(ts, value);
+      step_vals.emplace_back(ts, values[i]);
     }
   }
 }
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <limits>
+#include <memory>
 #include <QPainter>
 
 #include "tools/cabana/streams/abstractstream.h"
@@ -19,10 +20,13 @@ void Sparkline::update(const MessageId &msg_id, const cabana::Signal *sig, doubl
   }
 
   points.clear();
-  double value = 0;
-  for (auto it = first; it != last; ++it) {
-    if (sig->getValue((*it)->dat, (*it)->size, &value)) {
-      points.emplace_back(((*it)->mono_time - (*first)->mono_time) / 1e9, value);
+  const size_t n = std::distance(first, last);
+  std::vector<double> values(n);
+  std::unique_ptr<bool[]> valid(new bool[n]);
+  sig->getValues(&(*first), n, values.data(), valid.get());
+  for (size_t i = 0; i < n; ++i) {
+    if (valid[i]) {
+      points.emplace_back((first[i]->mono_time - (*first)->mono_time) / 1e9, values[i]);
     }
   }
 
@@ -179,25 +179,7 @@ bool cabana::Signal::operator==(const cabana::Signal &other) const {
 // helper functions
 
 double get_raw_value(const uint8_t *data, size_t data_size, const cabana::Signal &sig) {
-  int64_t val = 0;
-
-  int i = sig.msb / 8;
-  int bits = sig.size;
-  while (i >= 0 && i < data_size && bits > 0) {
-    int lsb = (int)(sig.lsb / 8) == i ? sig.lsb : i * 8;
-    int msb = (int)(sig.msb / 8) == i ? sig.msb : (i + 1) * 8 - 1;
-    int size = msb - lsb + 1;
-
-    uint64_t d = (data[i] >> (lsb - (i * 8))) & ((1ULL << size) - 1);
-    val |= d << (bits - size);
-
-    bits -= size;
-    i = sig.is_little_endian ? i - 1 : i + 1;
-  }
-  if (sig.is_signed) {
-    val -= ((val >> (sig.size - 1)) & 0x1) ? (1ULL << sig.size) : 0;
-  }
-  return val * sig.factor + sig.offset;
+  return sig.toValue(sig.extractor.raw(data, data_size));
 }
 
 void updateMsbLsb(cabana::Signal &s) {
@@ -208,4 +190,5 @@ void updateMsbLsb(cabana::Signal &s) {
     s.lsb = flipBitPos(flipBitPos(s.start_bit) + s.size - 1);
     s.msb = s.start_bit;
   }
+  s.extractor = SignalExtractor(s.msb, s.lsb, s.size, s.is_little_endian);
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <algorithm>
+#include <iterator>
 #include <limits>
 #include <utility>
 #include <vector>
@@ -8,6 +10,7 @@
 #include <QMetaType>
 #include <QString>
 
+#include "opendbc/can/signal_extractor.h"
 
 const QString UNTITLED = "untitled";
 const QString DEFAULT_NODE_NAME = "XXX";
@@ -55,6 +58,12 @@ public:
   Signal(const Signal &other) = default;
   void update();
   bool getValue(const uint8_t *data, size_t data_size, double *val) const;
+  // decode this signal across n events. valid[i] is false if a multiplexed signal is not present in events[i].
+  template <typename Event>
+  void getValues(const Event *const *events, size_t n, double *values, bool *valid) const;
+  inline double toValue(uint64_t raw) const {
+    return (is_signed ? SignalExtractor::sign_extend(raw, size) : (int64_t)raw) * factor + offset;
+  }
   QString formatValue(double value, bool with_unit = true) const;
   bool operator==(const cabana::Signal &other) const;
   inline bool operator!=(const cabana::Signal &other) const { return !(*this == other); }
@@ -83,8 +92,30 @@ public:
   // Multiplexed
   int multiplex_value = 0;
   Signal *multiplexor = nullptr;
+
+  SignalExtractor extractor;  // updated by updateMsbLsb()
 };
 
+template <typename Event>
+void Signal::getValues(const Event *const *events, size_t n, double *values, bool *valid) const {
+  uint64_t raw[256];
+  for (size_t i = 0; i < n; i += std::size(raw)) {
+    const size_t count = std::min(n - i, std::size(raw));
+    extractor.raw(events + i, count, raw);
+    for (size_t j = 0; j < count; ++j) {
+      values[i + j] = toValue(raw[j]);
+    }
+    if (multiplexor) {
+      multiplexor->extractor.raw(events + i, count, raw);
+      for (size_t j = 0; j < count; ++j) {
+        valid[i + j] = multiplexor->toValue(raw[j]) == multiplex_value;
+      }
+    } else {
+      std::fill(valid + i, valid + i + count, true);
+    }
+  }
+}
+
 class Msg {
 public:
   Msg() = default;
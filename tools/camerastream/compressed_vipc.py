@@ -22,6 +22,12 @@ ENCODE_SOCKETS = {
   VisionStreamType.VISION_STREAM_DRIVER: "driverEncodeData",
 }
 
+def check_inline_packets(ed, sock_name):
+  # by default encoderd hands the packets to loggerd through shared memory, they're only in the message with
+  # ENCODERD_INLINE_PACKETS=1 set on the device
+  if ed.inRing:
+    raise RuntimeError(f"{sock_name} packets aren't in the messages, start encoderd with ENCODERD_INLINE_PACKETS=1")
+
 def decoder(addr, vipc_server, vst, nvidia, W, H, debug=False):
   sock_name = ENCODE_SOCKETS[vst]
   if debug:
@@ -52,6 +58,7 @@ def decoder(addr, vipc_server, vst, nvidia, W, H, debug=False):
     msgs = messaging.drain_sock(sock, wait_for_one=True)
     for evt in msgs:
       evta = getattr(evt, evt.which())
+      check_inline_packets(evta, sock_name)
       if debug and evta.idx.encodeId != 0 and evta.idx.encodeId != (last_idx+1):
         print("DROP PACKET!")
       last_idx = evta.idx.encodeId
@@ -115,6 +122,9 @@ class CompressedVipc:
     os.environ.pop("ZMQ")
     messaging.context = messaging.Context()
 
+    for vst in vision_streams:
+      check_inline_packets(sm[ENCODE_SOCKETS[vst]], ENCODE_SOCKETS[vst])
+
     self.vipc_server = VisionIpcServer("camerad")
     for vst in vision_streams:
       ed = sm[ENCODE_SOCKETS[vst]]
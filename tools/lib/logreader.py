@@ -1,6 +1,7 @@
 #!/usr/bin/env python3
 import bz2
 from functools import partial
+import io
 import multiprocessing
 import capnp
 import enum
@@ -21,6 +22,8 @@ from openpilot.tools.lib.openpilotci import get_url
 from openpilot.tools.lib.filereader import FileReader, file_exists, internal_source_available
 from openpilot.tools.lib.route import Route, SegmentRange
 
+ZSTD_MAGIC = b'\x28\xb5\x2f\xfd'
+
 LogMessage = type[capnp._DynamicStructReader]
 LogIterable = Iterable[LogMessage]
 RawLogIterable = Iterable[bytes]
@@ -34,7 +37,7 @@ class _LogFileReader:
     ext = None
     if not dat:
       _, ext = os.path.splitext(urllib.parse.urlparse(fn).path)
-      if ext not in ('', '.bz2'):
+      if ext not in ('', '.bz2', '.zst'):
         # old rlogs weren't bz2 compressed
         raise Exception(f"unknown extension {ext}")
 
@@ -43,6 +46,11 @@ class _LogFileReader:
 
     if ext == ".bz2" or dat.startswith(b'BZh9'):
       dat = bz2.decompress(dat)
+    elif ext == ".zst" or dat.startswith(ZSTD_MAGIC):
+      # only needed for logs written by newer loggerd
+      import zstandard as zstd
+      # logs are written as many zstd frames
+      dat = zstd.ZstdDecompressor().stream_reader(io.BytesIO(dat), read_across_frames=True).read()
 
     ents = capnp_log.Event.read_multiple_bytes(dat)
 
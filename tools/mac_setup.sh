@@ -63,6 +63,7 @@ brew "pyenv"
 brew "pyenv-virtualenv"
 brew "qt@5"
 brew "zeromq"
+brew "zstd"
 cask "gcc-arm-embedded"
 brew "portaudio"
 EOS
@@ -0,0 +1,140 @@
+#include "tools/replay/candecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include "tools/replay/util.h"
+
+// number of events decoded by one task. A single log is split into several tasks.
+const size_t CHUNK_EVENTS = 10000;
+
+static void parallel_for(size_t n, int num_threads, const std::function<void(size_t)> &fn) {
+  std::atomic<size_t> next = 0;
+  std::vector<std::thread> workers;
+  for (int i = 0; i < std::min<size_t>(num_threads, n); ++i) {
+    workers.emplace_back([&]() {
+      for (size_t j = next++; j < n; j = next++) {
+        fn(j);
+      }
+    });
+  }
+  for (auto &t : workers) {
+    t.join();
+  }
+}
+
+CanDecoder::CanDecoder(const std::string &dbc_name, int bus, bool ignore_checksum, bool ignore_counter)
+  : bus(bus), ignore_checksum(ignore_checksum), ignore_counter(ignore_counter) {
+  dbc = dbc_lookup(dbc_name);
+  if (!dbc) {
+    throw std::runtime_error("Can't find DBC: " + dbc_name);
+  }
+  for (int i = 0; i < dbc->msgs.size(); ++i) {
+    msg_index[dbc->msgs[i].address] = i;
+  }
+}
+
+bool CanDecoder::decode(const std::vector<std::string> &log_urls, int num_threads, std::atomic<bool> *abort) {
+  if (num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // download, decompress and index all logs, keeping only the can events
+  std::vector<bool> filters((size_t)cereal::Event::Which::CAN + 1, false);
+  filters[(size_t)cereal::Event::Which::CAN] = true;
+  std::vector<std::unique_ptr<LogReader>> logs(log_urls.size());
+  parallel_for(log_urls.size(), num_threads, [&](size_t i) {
+    logs[i] = std::make_unique<LogReader>(filters);
+    if (!logs[i]->load(log_urls[i], abort)) {
+      rWarning("failed to load log %s", log_urls[i].c_str());
+    }
+  });
+
+  // decode fixed-size slices of every log in parallel
+  std::vector<Chunk> chunks;
+  for (const auto &log : logs) {
+    const auto &events = log->events;
+    for (size_t i = 0; i < events.size(); i += CHUNK_EVENTS) {
+      Chunk &c = chunks.emplace_back();
+      c.begin = events.begin() + i;
+      c.end = events.begin() + std::min(i + CHUNK_EVENTS, events.size());
+    }
+  }
+  parallel_for(chunks.size(), num_threads, [&](size_t i) { decodeChunk(chunks[i], abort); });
+  if (abort && *abort) {
+    return false;
+  }
+
+  // concatenate the chunks, in log order, into one column per signal
+  messages.clear();
+  for (int m = 0; m < dbc->msgs.size(); ++m) {
+    size_t total = 0;
+    for (const auto &c : chunks) total += c.mono_times[m].size();
+    if (total == 0) continue;
+
+    const Msg &msg = dbc->msgs[m];
+    CanMessageColumns &cols = messages.emplace_back();
+    cols.address = msg.address;
+    cols.name = msg.name;
+    cols.mono_times.reserve(total);
+    cols.values.resize(msg.sigs.size());
+    for (int s = 0; s < msg.sigs.size(); ++s) {
+      cols.signal_names.push_back(msg.sigs[s].name);
+      cols.values[s].reserve(total);
+    }
+    for (auto &c : chunks) {
+      cols.mono_times.insert(cols.mono_times.end(), c.mono_times[m].begin(), c.mono_times[m].end());
+      for (int s = 0; s < msg.sigs.size(); ++s) {
+        auto &vals = c.states[m].all_vals[s];
+        cols.values[s].insert(cols.values[s].end(), vals.begin(), vals.end());
+        std::vector<double>().swap(vals);
+      }
+    }
+  }
+  return !messages.empty();
+}
+
+void CanDecoder::decodeChunk(Chunk &chunk, std::atomic<bool> *abort) {
+  chunk.states.resize(dbc->msgs.size());
+  chunk.mono_times.resize(dbc->msgs.size());
+  for (int i = 0; i < dbc->msgs.size(); ++i) {
+    const Msg &msg = dbc->msgs[i];
+    MessageState &state = chunk.states[i];
+    state.name = msg.name;
+    state.address = msg.address;
+    state.size = msg.size;
+    state.parse_sigs = msg.sigs;
+    state.vals.resize(msg.sigs.size());
+    state.all_vals.resize(msg.sigs.size());
+    state.ignore_checksum = ignore_checksum;
+    state.ignore_counter = ignore_counter;
+  }
+
+  std::vector<uint8_t> data;
+  data.reserve(64);
+  for (auto it = chunk.begin; it != chunk.end && !(abort && *abort); ++it) {
+    if (it->which != cereal::Event::Which::CAN) continue;
+
+    capnp::FlatArrayMessageReader reader(it->data);
+    for (const auto c : reader.getRoot<cereal::Event>().getCan()) {
+      if (c.getSrc() != bus) continue;
+
+      auto idx_it = msg_index.find(c.getAddress());
+      if (idx_it == msg_index.end()) continue;
+
+      auto dat = c.getDat();
+      if (dat.size() > 64) continue;
+
+      MessageState &state = chunk.states[idx_it->second];
+      data.assign(std::max<size_t>(dat.size(), state.size), 0);
+      memcpy(data.data(), dat.begin(), dat.size());
+      if (state.parse(it->mono_time, data)) {
+        chunk.mono_times[idx_it->second].push_back(it->mono_time);
+      }
+    }
+  }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "opendbc/can/common.h"
+#include "tools/replay/logreader.h"
+
+// Decoded signals of one CAN message, stored column-wise: values[i][j] is signal_names[i] at mono_times[j].
+struct CanMessageColumns {
+  uint32_t address;
+  std::string name;
+  std::vector<std::string> signal_names;
+  std::vector<uint64_t> mono_times;
+  std::vector<std::vector<double>> values;
+};
+
+// Batch CAN decoder for offline analysis. Logs are loaded and decoded on a pool of worker
+// threads, the results of all logs are concatenated in the order the logs are given.
+class CanDecoder {
+public:
+  CanDecoder(const std::string &dbc_name, int bus, bool ignore_checksum = true, bool ignore_counter = true);
+  bool decode(const std::vector<std::string> &log_urls, int num_threads = 0, std::atomic<bool> *abort = nullptr);
+  std::vector<CanMessageColumns> messages;
+
+private:
+  struct Chunk {
+    std::vector<Event>::const_iterator begin, end;
+    std::vector<MessageState> states;  // indexed like dbc->msgs
+    std::vector<std::vector<uint64_t>> mono_times;
+  };
+  void decodeChunk(Chunk &chunk, std::atomic<bool> *abort);
+
+  const DBC *dbc = nullptr;
+  const int bus;
+  const bool ignore_checksum, ignore_counter;
+  std::unordered_map<uint32_t, int> msg_index;
+};
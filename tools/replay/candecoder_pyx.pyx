@@ -0,0 +1,70 @@
+# distutils: language = c++
+# cython: c_string_encoding=ascii, language_level=3
+
+from cpython.ref cimport Py_INCREF
+from libc.stdint cimport uint32_t, uint64_t
+from libcpp cimport bool
+from libcpp.string cimport string
+from libcpp.vector cimport vector
+
+import numpy as np
+cimport numpy as cnp
+
+cnp.import_array()
+
+
+cdef extern from "tools/replay/candecoder.h":
+  cdef cppclass CanMessageColumns:
+    uint32_t address
+    string name
+    vector[string] signal_names
+    vector[uint64_t] mono_times
+    vector[vector[double]] values
+
+  cdef cppclass CanDecoder:
+    CanDecoder(string, int, bool, bool) except +
+    bool decode(vector[string]&, int) nogil
+    vector[CanMessageColumns] messages
+
+
+cdef class _DecodedColumns:
+  # keeps the decoded columns alive for as long as any array references them
+  cdef CanDecoder *decoder
+
+  def __dealloc__(self):
+    if self.decoder:
+      del self.decoder
+
+
+cdef cnp.ndarray _wrap(void *data, size_t size, int typenum, _DecodedColumns owner):
+  cdef cnp.npy_intp shape = size
+  cdef cnp.ndarray arr = cnp.PyArray_SimpleNewFromData(1, &shape, typenum, data)
+  Py_INCREF(owner)  # PyArray_SetBaseObject steals a reference
+  cnp.PyArray_SetBaseObject(arr, owner)
+  return arr
+
+
+def decode_can(dbc_name, log_urls, bus=0, num_threads=0, ignore_checksum=True, ignore_counter=True):
+  """Decode all CAN frames of the given logs (paths or urls) on a thread pool.
+
+  Returns {message name: {"t": logMonoTime array, signal name: value array}}. The arrays are views
+  of the decoded C++ columns, no data is copied."""
+  cdef _DecodedColumns owner = _DecodedColumns()
+  owner.decoder = new CanDecoder(dbc_name.encode("utf8"), bus, ignore_checksum, ignore_counter)
+
+  cdef vector[string] urls
+  for url in log_urls:
+    urls.push_back(url.encode("utf8"))
+  cdef int threads = num_threads
+  with nogil:
+    owner.decoder.decode(urls, threads)
+
+  ret = {}
+  cdef CanMessageColumns *m
+  for i in range(owner.decoder.messages.size()):
+    m = &owner.decoder.messages[i]
+    cols = {"t": _wrap(m.mono_times.data(), m.mono_times.size(), cnp.NPY_UINT64, owner)}
+    for s in range(m.signal_names.size()):
+      cols[m.signal_names[s].decode("utf8")] = _wrap(m.values[s].data(), m.values[s].size(), cnp.NPY_FLOAT64, owner)
+    ret[m.name.decode("utf8")] = cols
+  return ret
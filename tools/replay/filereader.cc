@@ -1,11 +1,14 @@
 #include "tools/replay/filereader.h"
 
+#include <cstdio>
 #include <fstream>
 
 #include "common/util.h"
 #include "system/hardware/hw.h"
 #include "tools/replay/util.h"
 
+const size_t FILE_READ_CHUNK_SIZE = 1024 * 1024;
+
 std::string cacheFilePath(const std::string &url) {
   static std::string cache_path = [] {
     const std::string comma_cache = Path::download_cache_root();
@@ -33,6 +36,53 @@ std::string FileReader::read(const std::string &file, std::atomic<bool> *abort)
   return result;
 }
 
+bool FileReader::read(const std::string &file, const DownloadDataHandler &handler, std::atomic<bool> *abort) {
+  const bool is_remote = file.find("https://") == 0;
+  const std::string local_file = is_remote ? cacheFilePath(file) : file;
+
+  if ((!is_remote || cache_to_local_) && util::file_exists(local_file)) {
+    std::ifstream fs(local_file, std::ios::binary | std::ios::in);
+    std::string buf(FILE_READ_CHUNK_SIZE, '\0');
+    while (fs && !(abort && *abort)) {
+      fs.read(buf.data(), buf.size());
+      if (fs.gcount() > 0 && !handler(buf.data(), fs.gcount())) return false;
+    }
+    return fs.eof();
+  } else if (!is_remote) {
+    return false;
+  }
+
+  // the cache file is only put in place once the download is complete
+  const std::string tmp_file = local_file + ".tmp";
+  std::ofstream cache;
+  if (cache_to_local_) cache.open(tmp_file, std::ios::binary | std::ios::out | std::ios::trunc);
+
+  // what the handler got can't be taken back, a retry resumes where the download stopped
+  size_t received = 0;
+  bool stopped = false, success = false;
+  for (int i = 0; i <= max_retries_ && !success && !stopped && !(abort && *abort); ++i) {
+    if (i > 0) {
+      rWarning("download failed, retrying %d from %zu bytes", i, received);
+      util::sleep_for(3000);
+    }
+    success = httpDownload(file, [&](const char *data, size_t size) {
+      if (!handler(data, size)) {
+        stopped = true;
+        return false;
+      }
+      received += size;
+      if (cache.is_open()) cache.write(data, size);
+      return true;
+    }, abort, received);
+  }
+
+  if (cache.is_open()) {
+    cache.close();
+    if (!success || std::rename(tmp_file.c_str(), local_file.c_str()) != 0) std::remove(tmp_file.c_str());
+  }
+  return success;
+}
+
 std::string FileReader::download(const std::string &url, std::atomic<bool> *abort) {
   for (int i = 0; i <= max_retries_ && !(abort && *abort); ++i) {
     if (i > 0) {
@@ -3,12 +3,17 @@
 #include <atomic>
 #include <string>
 
+#include "tools/replay/util.h"
+
 class FileReader {
 public:
   FileReader(bool cache_to_local, size_t chunk_size = 0, int retries = 3)
       : cache_to_local_(cache_to_local), chunk_size_(chunk_size), max_retries_(retries) {}
   virtual ~FileReader() {}
   std::string read(const std::string &file, std::atomic<bool> *abort = nullptr);
+  // hands the file over a piece at a time as it's read or downloaded, a download goes over one
+  // connection. Stops if the handler returns false
+  bool read(const std::string &file, const DownloadDataHandler &handler, std::atomic<bool> *abort = nullptr);
 
 private:
   std::string download(const std::string &url, std::atomic<bool> *abort);
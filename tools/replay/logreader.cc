@@ -1,31 +1,234 @@
 #include "tools/replay/logreader.h"
 
+#include <zstd.h>
+
 #include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <thread>
 #include <utility>
+
+#include "common/queue.h"
+#include "common/util.h"
 #include "tools/replay/filereader.h"
 #include "tools/replay/util.h"
 
+// chunks handed from the reader to the decompressor, and from the decompressor to the parser
+const size_t COMPRESSED_CHUNK_SIZE = 1024 * 1024;
+const size_t DECOMPRESSED_CHUNK_SIZE = 4 * 1024 * 1024;
+const int PIPELINE_CHUNKS = 4;
+// the blocks of the decompressed log grow from the first size to the largest
+const size_t LOG_BLOCK_SIZE = 4 * 1024 * 1024;
+const size_t LOG_BLOCK_MAX_SIZE = 64 * 1024 * 1024;
+
+struct LogChunk {
+  LogChunk(size_t capacity) : data(new char[capacity]), capacity(capacity) {}
+  std::unique_ptr<char[]> data;
+  const size_t capacity;
+  size_t size = 0;
+};
+typedef std::shared_ptr<LogChunk> Chunk;
+
+// a fixed number of chunks going around between two threads, a null chunk marks the end
+struct ChunkQueue {
+  ChunkQueue(size_t chunk_size) {
+    for (int i = 0; i < PIPELINE_CHUNKS; ++i) {
+      free.push(std::make_shared<LogChunk>(chunk_size));
+    }
+  }
+  SafeQueue<Chunk> full, free;
+};
+
 bool LogReader::load(const std::string &url, std::atomic<bool> *abort, bool local_cache, int chunk_size, int retries) {
-  std::string data = FileReader(local_cache, chunk_size, retries).read(url, abort);
-  if (!data.empty() && url.find(".bz2") != std::string::npos)
-    data = decompressBZ2(data, abort);
-
-  bool success = !data.empty() && load(data.data(), data.size(), abort);
-  if (filters_.empty())
-    raw_ = std::move(data);
-  return success;
+  // with filters, only the frames holding the wanted services need to be read and decompressed
+  if (!filters_.empty() && url.find(".zst") != std::string::npos && util::file_exists(log_index_path(url))) {
+    auto index = log_index_parse(util::read_file(log_index_path(url)));
+    if (!index.empty() && loadZstdFrames(url, index, abort)) return finish(abort);
+  }
+
+  auto type = StreamDecompressor::Type::NONE;
+  if (url.find(".zst") != std::string::npos) type = StreamDecompressor::Type::ZSTD;
+  if (url.find(".bz2") != std::string::npos) type = StreamDecompressor::Type::BZ2;
+
+  // every stage keeps taking chunks until the end, after a stop it only hands them back
+  std::atomic<bool> stop = false;
+  auto stopped = [&]() { return stop || (abort && *abort); };
+  ChunkQueue compressed(COMPRESSED_CHUNK_SIZE), decompressed(DECOMPRESSED_CHUNK_SIZE);
+
+  bool read_success = false;
+  std::thread reader([&]() {
+    util::set_thread_name("logreader_read");
+    Chunk chunk = compressed.free.pop();
+    read_success = FileReader(local_cache, chunk_size, retries).read(url, [&](const char *data, size_t size) {
+      while (size > 0 && !stopped()) {
+        const size_t n = std::min(size, chunk->capacity - chunk->size);
+        memcpy(chunk->data.get() + chunk->size, data, n);
+        chunk->size += n;
+        data += n;
+        size -= n;
+        if (chunk->size == chunk->capacity) {
+          compressed.full.push(chunk);
+          chunk = compressed.free.pop();
+        }
+      }
+      return !stopped();
+    }, abort);
+    if (chunk->size > 0) compressed.full.push(chunk);
+    compressed.full.push(nullptr);
+  });
+
+  std::thread decompressor([&]() {
+    util::set_thread_name("logreader_decompress");
+    StreamDecompressor dec(type);
+    Chunk out;
+    for (Chunk in = compressed.full.pop(); in; in = compressed.full.pop()) {
+      const char *in_data = in->data.get();
+      size_t in_size = in->size;
+      // until the input is used up, and while the output fills up, the decompressor may hold more
+      bool out_full = false;
+      while (!stopped() && (in_size > 0 || out_full)) {
+        if (!out) out = decompressed.free.pop();
+        char *out_data = out->data.get() + out->size;
+        size_t out_avail = out->capacity - out->size;
+        if (!dec.decompress(in_data, in_size, out_data, out_avail)) {
+          stop = true;
+        }
+        out->size = out->capacity - out_avail;
+        out_full = out_avail == 0;
+        if (out_full) {
+          decompressed.full.push(out);
+          out = nullptr;
+        }
+      }
+      // hand over what's there, so the parser doesn't wait for a full chunk
+      if (out && out->size > 0) {
+        decompressed.full.push(out);
+        out = nullptr;
+      }
+      in->size = 0;
+      compressed.free.push(in);
+    }
+    if (out) decompressed.free.push(out);
+    decompressed.full.push(nullptr);
+  });
+
+  // the decompressed chunks are appended to the current block and parsed. An event that continues
+  // in the next chunk moves to a new block if that doesn't fit
+  events.reserve(65000);
+  std::string *block = nullptr;
+  size_t pos = 0, next_block_size = LOG_BLOCK_SIZE;
+  for (Chunk chunk = decompressed.full.pop(); chunk; chunk = decompressed.full.pop()) {
+    if (!stopped()) {
+      if (!block || block->size() + chunk->size > block->capacity()) {
+        const size_t rest = block ? block->size() - pos : 0;
+        if (filters_.empty() || !block) {
+          // the events point into the blocks, they're never reallocated
+          std::string &b = blocks_.emplace_back();
+          b.reserve(std::max(next_block_size, rest + chunk->size));
+          next_block_size = std::min(next_block_size * 2, LOG_BLOCK_MAX_SIZE);
+          if (block) {
+            b.append(block->data() + pos, rest);
+            block->resize(pos);
+          }
+          block = &b;
+        } else {
+          // with filters the events are copied out, so the block is reused
+          block->erase(0, pos);
+        }
+        pos = 0;
+      }
+      block->append(chunk->data.get(), chunk->size);
+      if (!parse(block->data(), block->size(), pos, abort)) {
+        stop = true;
+      }
+      sortRun();
+    }
+    chunk->size = 0;
+    decompressed.free.push(chunk);
+  }
+  reader.join();
+  decompressor.join();
+
+  // a log that couldn't be read to the end is incomplete, unlike one that's corrupt
+  if (!read_success && !stopped()) {
+    if (!events.empty()) rWarning("Failed to read %s to the end, dropping %zu events", url.c_str(), events.size());
+    events.clear();
+    return false;
+  }
+  if (block && pos < block->size() && !stopped()) {
+    rWarning("Failed to parse log : truncated.\nRetrieved %zu events from corrupt log", events.size());
+  }
+  return finish(abort);
 }
 
 bool LogReader::load(const char *data, size_t size, std::atomic<bool> *abort) {
+  events.reserve(65000);
+  size_t pos = 0;
+  if (parse(data, size, pos, abort) && pos < size) {
+    rWarning("Failed to parse log : truncated.\nRetrieved %zu events from corrupt log", events.size());
+  }
+  return finish(abort);
+}
+
+// Reads, decompresses and parses only the frames of the index that hold a service in the filters.
+// Returns false, with no events added, if the index doesn't match the log.
+bool LogReader::loadZstdFrames(const std::string &file, const std::vector<LogIndexEntry> &index, std::atomic<bool> *abort) {
+  // the frames of the index have to cover the whole log, one after the other
+  std::ifstream fs(file, std::ios::binary | std::ios::in | std::ios::ate);
+  uint64_t end = 0;
+  for (const auto &frame : index) {
+    if (frame.offset != end) break;
+    end += frame.size;
+  }
+  if (!fs || end != (uint64_t)fs.tellg()) {
+    rWarning("Log index of %s doesn't match the log, reading the whole log", file.c_str());
+    return false;
+  }
+
+  std::string compressed, data;
+  events.reserve(65000);
+  for (const auto &frame : index) {
+    if (abort && *abort) break;
+
+    bool wanted = false;
+    for (size_t which = 0; which < filters_.size() && !wanted; ++which) {
+      wanted = filters_[which] && frame.hasService(which);
+    }
+    if (!wanted) continue;
+
+    // events are copied out of the frame with filters set, so the buffers are reused
+    compressed.resize(frame.size);
+    data.resize(frame.decompressed_size);
+    fs.seekg(frame.offset);
+    size_t ret = fs.read(compressed.data(), compressed.size()) ? ZSTD_decompress(data.data(), data.size(), compressed.data(), compressed.size()) : 0;
+    size_t pos = 0;
+    if (ZSTD_isError(ret) || ret != data.size() || !parse(data.data(), data.size(), pos, abort) || (pos < data.size() && !(abort && *abort))) {
+      rWarning("Failed to load log frame at %zu of %s, reading the whole log", (size_t)frame.offset, file.c_str());
+      events.clear();
+      runs_.clear();
+      return false;
+    }
+    sortRun();
+  }
+  return true;
+}
+
+// parses the complete events in data[pos, size), and advances pos past them
+bool LogReader::parse(const char *data, size_t size, size_t &pos, std::atomic<bool> *abort) {
   try {
-    events.reserve(65000);
-    kj::ArrayPtr<const capnp::word> words((const capnp::word *)data, size / sizeof(capnp::word));
+    kj::ArrayPtr<const capnp::word> words((const capnp::word *)(data + pos), (size - pos) / sizeof(capnp::word));
     while (words.size() > 0 && !(abort && *abort)) {
+      // the rest of the event is still compressed
+      if (capnp::expectedSizeInWordsFromPrefix(words) > words.size())
+        break;
+
       capnp::FlatArrayMessageReader reader(words);
       auto event = reader.getRoot<cereal::Event>();
       auto which = event.which();
       auto event_data = kj::arrayPtr(words.begin(), reader.getEnd());
       words = kj::arrayPtr(reader.getEnd(), words.end());
+      pos = (const char *)words.begin() - data;
 
       if (!filters_.empty()) {
         if (which >= filters_.size() || !filters_[which])
@@ -50,11 +253,41 @@ bool LogReader::load(const char *data, size_t size, std::atomic<bool> *abort) {
     }
   } catch (const kj::Exception &e) {
     rWarning("Failed to parse log : %s.\nRetrieved %zu events from corrupt log", e.getDescription().cStr(), events.size());
+    return false;
+  }
+  return true;
+}
+
+// sorts the events added since the last run
+void LogReader::sortRun() {
+  const size_t start = runs_.empty() ? 0 : runs_.back();
+  if (events.size() > start) {
+    std::sort(events.begin() + start, events.end());
+    runs_.push_back(events.size());
   }
+}
 
+bool LogReader::finish(std::atomic<bool> *abort) {
   if (!events.empty() && !(abort && *abort)) {
+    sortRun();
+    // merge the sorted runs pairwise, runs that are already in order are left as they are
+    std::vector<size_t> bounds = {0};
+    bounds.insert(bounds.end(), runs_.begin(), runs_.end());
+    while (bounds.size() > 2) {
+      std::vector<size_t> merged = {0};
+      for (size_t i = 0; i + 1 < bounds.size(); i += 2) {
+        if (i + 2 < bounds.size()) {
+          auto mid = events.begin() + bounds[i + 1];
+          if (*mid < *(mid - 1)) {
+            std::inplace_merge(events.begin() + bounds[i], mid, events.begin() + bounds[i + 2]);
+          }
+        }
+        merged.push_back(bounds[std::min(i + 2, bounds.size() - 1)]);
+      }
+      bounds = std::move(merged);
+    }
+    runs_ = {events.size()};
     events.shrink_to_fit();
-    std::sort(events.begin(), events.end());
     return true;
   }
   return false;
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <deque>
 #include <string>
 #include <vector>
 
 #include "cereal/gen/cpp/log.capnp.h"
 #include "system/camerad/cameras/camera_common.h"
+#include "system/loggerd/log_index.h"
 #include "tools/replay/util.h"
 
 const CameraType ALL_CAMERAS[] = {RoadCam, DriverCam, WideRoadCam};
@@ -25,6 +27,10 @@ public:
   int32_t eidx_segnum;
 };
 
+// Loads a log in a pipeline: reading or downloading, decompression and parsing run on their own
+// threads and hand chunks to each other through a few buffers that are reused, so they overlap and
+// only the parsed log is ever held in full. The events of every chunk are sorted as they're parsed,
+// and the sorted runs merged at the end.
 class LogReader {
 public:
   LogReader(const std::vector<bool> &filters = {}) { filters_ = filters; }
@@ -34,7 +40,15 @@ public:
   std::vector<Event> events;
 
 private:
-  std::string raw_;
+  bool loadZstdFrames(const std::string &file, const std::vector<LogIndexEntry> &index, std::atomic<bool> *abort);
+  bool parse(const char *data, size_t size, size_t &pos, std::atomic<bool> *abort);
+  void sortRun();
+  bool finish(std::atomic<bool> *abort);
+
+  // the decompressed log the events point into, without filters. Blocks are only appended to
+  std::deque<std::string> blocks_;
+  // ends of the sorted runs of events
+  std::vector<size_t> runs_;
   std::vector<bool> filters_;
   MonotonicBuffer buffer_{1024 * 1024};
 };
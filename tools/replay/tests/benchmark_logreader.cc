@@ -0,0 +1,62 @@
+// Load time and peak RSS of LogReader's pipelined load against reading, decompressing and parsing
+// the whole log one step after the other. Every run is a child process so its peak RSS is its own.
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+
+#include "common/timing.h"
+#include "tools/replay/filereader.h"
+#include "tools/replay/logreader.h"
+#include "tools/replay/util.h"
+
+size_t load_sequential(const std::string &url) {
+  std::string data = FileReader(true).read(url);
+  if (url.find(".zst") != std::string::npos) {
+    data = decompressZST(data);
+  } else if (url.find(".bz2") != std::string::npos) {
+    data = decompressBZ2(data);
+  }
+  LogReader log;
+  log.load(data.data(), data.size());
+  return log.events.size();
+}
+
+size_t load_pipelined(const std::string &url) {
+  LogReader log;
+  log.load(url, nullptr, true);
+  return log.events.size();
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    printf("usage: %s <rlog or url> [runs]\n", argv[0]);
+    return 1;
+  }
+  const std::string url = argv[1];
+  const int runs = argc > 2 ? atoi(argv[2]) : 3;
+
+  // the first run downloads the log to the cache
+  FileReader(true).read(url);
+
+  for (auto [name, load] : {std::pair{"sequential", load_sequential}, std::pair{"pipelined", load_pipelined}}) {
+    for (int i = 0; i < runs; ++i) {
+      fflush(stdout);
+      pid_t pid = fork();
+      if (pid == 0) {
+        double t = millis_since_boot();
+        size_t events = load(url);
+        printf("%s: %zu events in %.1f ms", name, events, millis_since_boot() - t);
+        fflush(stdout);
+        _exit(0);
+      }
+      struct rusage usage = {};
+      int status = 0;
+      wait4(pid, &status, 0, &usage);
+      printf(", peak RSS %.1f MB\n", usage.ru_maxrss / 1024.0);
+    }
+  }
+  return 0;
+}
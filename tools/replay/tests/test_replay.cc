@@ -1,10 +1,15 @@
+#include <zstd.h>
+
+#include <algorithm>
 #include <chrono>
 #include <thread>
+#include <tuple>
 
 #include <QEventLoop>
 
 #include "catch2/catch.hpp"
 #include "common/util.h"
+#include "tools/replay/candecoder.h"
 #include "tools/replay/replay.h"
 #include "tools/replay/util.h"
 
@@ -69,6 +74,115 @@ TEST_CASE("LogReader") {
     REQUIRE(log.load(corrupt_content.data(), corrupt_content.size()));
     REQUIRE(log.events.size() > 0);
   }
+
+  SECTION("streamed load") {
+    const std::string raw = decompressBZ2(FileReader(true).read(TEST_RLOG_URL));
+    REQUIRE(!raw.empty());
+
+    // the same log uncompressed, bz2 and as zstd frames of about 1MB of whole events with an index of
+    // the frames, the way loggerd writes it
+    const std::string dir = "/tmp/test_logreader_" + std::to_string(getpid());
+    REQUIRE(util::create_directories(dir, 0755));
+    std::string zst;
+    std::vector<LogIndexEntry> index;
+    LogIndexEntry entry;
+    size_t start = 0;
+    kj::ArrayPtr<const capnp::word> words((const capnp::word *)raw.data(), raw.size() / sizeof(capnp::word));
+    while (words.size() > 0) {
+      capnp::FlatArrayMessageReader reader(words);
+      auto event = reader.getRoot<cereal::Event>();
+      entry.add(event.getLogMonoTime(), event.which());
+      words = kj::arrayPtr(reader.getEnd(), words.end());
+      const size_t end = (const char *)words.begin() - raw.data();
+      if (end - start >= 1024 * 1024 || words.size() == 0) {
+        std::string frame(ZSTD_compressBound(end - start), '\0');
+        frame.resize(ZSTD_compress(frame.data(), frame.size(), raw.data() + start, end - start, 1));
+        entry.offset = zst.size();
+        entry.size = frame.size();
+        entry.decompressed_size = end - start;
+        index.push_back(entry);
+        zst += frame;
+        entry = {};
+        start = end;
+      }
+    }
+    REQUIRE(index.size() > 2);
+
+    // an index that doesn't match the log falls back to reading the whole log
+    auto truncated = index;
+    truncated.pop_back();
+    auto wrong_size = index;
+    wrong_size[1].decompressed_size += 8;
+
+    const std::tuple<std::string, std::string, std::vector<LogIndexEntry>> files[] = {
+      {dir + "/rlog", raw, {}},
+      {dir + "/rlog.bz2", util::read_file(cacheFilePath(TEST_RLOG_URL)), {}},
+      {dir + "/rlog.zst", zst, {}},
+      {dir + "/rlog.zst", zst, index},
+      {dir + "/rlog.zst", zst, truncated},
+      {dir + "/rlog.zst", zst, wrong_size},
+    };
+
+    std::vector<bool> filters;
+    SECTION("all services") {}
+    SECTION("with filters") {
+      filters.resize(256);
+      for (auto which : {cereal::Event::CAN, cereal::Event::CAR_STATE, cereal::Event::ROAD_ENCODE_IDX}) {
+        filters[which] = true;
+      }
+    }
+    LogReader expected(filters);
+    REQUIRE(expected.load(raw.data(), raw.size()));
+
+    for (const auto &[file, content, file_index] : files) {
+      INFO(file << " with " << file_index.size() << " index entries");
+      REQUIRE(util::write_file(file.c_str(), content.data(), content.size(), O_WRONLY | O_CREAT | O_TRUNC) == 0);
+      std::remove(log_index_path(file).c_str());
+      if (!file_index.empty()) {
+        const std::string idx = log_index_serialize(file_index);
+        REQUIRE(util::write_file(log_index_path(file).c_str(), idx.data(), idx.size(), O_WRONLY | O_CREAT | O_TRUNC) == 0);
+      }
+      LogReader log(filters);
+      REQUIRE(log.load(file));
+      REQUIRE(log.events.size() == expected.events.size());
+      for (size_t i = 0; i < log.events.size(); ++i) {
+        const Event &a = log.events[i];
+        REQUIRE(a.which == expected.events[i].which);
+        REQUIRE(a.mono_time == expected.events[i].mono_time);
+        // events that sort equal can be in any order
+        auto same = [&](const Event &b) {
+          return !(a < b) && !(b < a) && a.eidx_segnum == b.eidx_segnum && a.data.asBytes() == b.data.asBytes();
+        };
+        auto [lo, hi] = std::equal_range(expected.events.begin(), expected.events.end(), a);
+        REQUIRE(std::any_of(lo, hi, same));
+      }
+      std::remove(file.c_str());
+      std::remove(log_index_path(file).c_str());
+    }
+    rmdir(dir.c_str());
+  }
+}
+
+TEST_CASE("CanDecoder") {
+  const std::string dbc_name = "chrysler_pacifica_2017_hybrid_generated";
+  CanDecoder single(dbc_name, 0), parallel(dbc_name, 0);
+  REQUIRE(single.decode({TEST_RLOG_URL}, 1));
+  REQUIRE(parallel.decode({TEST_RLOG_URL, TEST_RLOG_URL}, 4));
+
+  REQUIRE(single.messages.size() == parallel.messages.size());
+  for (int i = 0; i < single.messages.size(); ++i) {
+    const auto &s = single.messages[i];
+    const auto &p = parallel.messages[i];
+    REQUIRE(s.address == p.address);
+    REQUIRE(std::is_sorted(s.mono_times.begin(), s.mono_times.end()));
+    // the second log is decoded into the back half of each column
+    REQUIRE(p.mono_times.size() == s.mono_times.size() * 2);
+    REQUIRE(std::equal(s.mono_times.begin(), s.mono_times.end(), p.mono_times.begin()));
+    for (int j = 0; j < s.values.size(); ++j) {
+      REQUIRE(s.values[j].size() == s.mono_times.size());
+      REQUIRE(std::equal(s.values[j].begin(), s.values[j].end(), p.values[j].begin() + s.values[j].size()));
+    }
+  }
 }
 
 void read_segment(int n, const SegmentFile &segment_file, uint32_t flags) {
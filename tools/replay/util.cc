@@ -3,6 +3,7 @@
 #include <bzlib.h>
 #include <curl/curl.h>
 #include <openssl/sha.h>
+#include <zstd.h>
 
 #include <cassert>
 #include <algorithm>
@@ -75,6 +76,8 @@ struct MultiPartWriter {
     } else if constexpr (std::is_same<T, std::ofstream>::value) {
       buf->seekp(offset);
       buf->write(data, bytes);
+    } else if constexpr (std::is_same<T, DownloadDataHandler>::value) {
+      if (!(*buf)(data, bytes)) return 0;
     }
 
     offset += bytes;
@@ -178,32 +181,33 @@ std::string getUrlWithoutQuery(const std::string &url) {
   return (idx == std::string::npos ? url : url.substr(0, idx));
 }
 
+// downloads [start, content_length) of the url
 template <class T>
-bool httpDownload(const std::string &url, T &buf, size_t chunk_size, size_t content_length, std::atomic<bool> *abort) {
+bool httpDownload(const std::string &url, T &buf, size_t chunk_size, size_t content_length, std::atomic<bool> *abort, size_t start = 0) {
   download_stats.add(url, content_length);
 
   int parts = 1;
-  if (chunk_size > 0 && content_length > 10 * 1024 * 1024) {
-    parts = std::nearbyint(content_length / (float)chunk_size);
+  if (chunk_size > 0 && content_length - start > 10 * 1024 * 1024) {
+    parts = std::nearbyint((content_length - start) / (float)chunk_size);
     parts = std::clamp(parts, 1, 5);
   }
 
   CURLM *cm = curl_multi_init();
-  size_t written = 0;
+  size_t written = start;
   std::map<CURL *, MultiPartWriter<T>> writers;
-  const int part_size = content_length / parts;
+  const size_t part_size = (content_length - start) / parts;
   for (int i = 0; i < parts; ++i) {
     CURL *eh = curl_easy_init();
     writers[eh] = {
         .buf = &buf,
         .total_written = &written,
-        .offset = (size_t)(i * part_size),
-        .end = i == parts - 1 ? content_length : (i + 1) * part_size,
+        .offset = start + i * part_size,
+        .end = i == parts - 1 ? content_length : start + (i + 1) * part_size,
     };
     curl_easy_setopt(eh, CURLOPT_WRITEFUNCTION, write_cb<T>);
     curl_easy_setopt(eh, CURLOPT_WRITEDATA, (void *)(&writers[eh]));
     curl_easy_setopt(eh, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(eh, CURLOPT_RANGE, util::string_format("%d-%d", writers[eh].offset, writers[eh].end - 1).c_str());
+    curl_easy_setopt(eh, CURLOPT_RANGE, util::string_format("%zu-%zu", writers[eh].offset, writers[eh].end - 1).c_str());
     curl_easy_setopt(eh, CURLOPT_HTTPGET, 1);
     curl_easy_setopt(eh, CURLOPT_NOSIGNAL, 1);
     curl_easy_setopt(eh, CURLOPT_FOLLOWLOCATION, 1);
@@ -212,7 +216,7 @@ bool httpDownload(const std::string &url, T &buf, size_t chunk_size, size_t cont
   }
 
   int still_running = 1;
-  size_t prev_written = 0;
+  size_t prev_written = start;
   while (still_running > 0 && !(abort && *abort)) {
     CURLMcode mc = curl_multi_perform(cm, &still_running);
     if (mc != CURLM_OK) {
@@ -277,6 +281,15 @@ bool httpDownload(const std::string &url, const std::string &file, size_t chunk_
   return httpDownload(url, of, chunk_size, size, abort);
 }
 
+bool httpDownload(const std::string &url, const DownloadDataHandler &handler, std::atomic<bool> *abort, size_t offset) {
+  size_t size = getRemoteFileSize(url, abort);
+  if (size == 0 || offset > size) return false;
+  if (offset == size) return true;
+
+  DownloadDataHandler h = handler;
+  return httpDownload(url, h, 0, size, abort, offset);
+}
+
 std::string decompressBZ2(const std::string &in, std::atomic<bool> *abort) {
   return decompressBZ2((std::byte *)in.data(), in.size(), abort);
 }
@@ -318,6 +331,101 @@ std::string decompressBZ2(const std::byte *in, size_t in_size, std::atomic<bool>
   return {};
 }
 
+std::string decompressZST(const std::string &in, std::atomic<bool> *abort) {
+  ZSTD_DCtx *dctx = ZSTD_createDCtx();
+  assert(dctx != nullptr);
+
+  ZSTD_inBuffer input = {in.data(), in.size(), 0};
+  std::string out(in.size() * 5, '\0');
+  size_t ret = 0;
+  while (input.pos < input.size && !(abort && *abort)) {
+    if (out.size() - ret < ZSTD_DStreamOutSize()) {
+      out.resize(out.size() * 2);
+    }
+    ZSTD_outBuffer output = {&out[ret], out.size() - ret, 0};
+    size_t err = ZSTD_decompressStream(dctx, &output, &input);
+    if (ZSTD_isError(err)) {
+      rWarning("decompressZST error : %s", ZSTD_getErrorName(err));
+      ZSTD_freeDCtx(dctx);
+      return {};
+    }
+    ret += output.pos;
+  }
+  ZSTD_freeDCtx(dctx);
+
+  if (abort && *abort) return {};
+  out.resize(ret);
+  out.shrink_to_fit();
+  return out;
+}
+
+StreamDecompressor::StreamDecompressor(Type type) : type(type) {
+  if (type == Type::BZ2) {
+    auto strm = new bz_stream{};
+    int bzerror = BZ2_bzDecompressInit(strm, 0, 0);
+    assert(bzerror == BZ_OK);
+    bz2 = strm;
+  } else if (type == Type::ZSTD) {
+    zstd = ZSTD_createDCtx();
+    assert(zstd != nullptr);
+  }
+}
+
+StreamDecompressor::~StreamDecompressor() {
+  if (bz2) {
+    BZ2_bzDecompressEnd((bz_stream *)bz2);
+    delete (bz_stream *)bz2;
+  }
+  if (zstd) ZSTD_freeDCtx((ZSTD_DCtx *)zstd);
+}
+
+bool StreamDecompressor::decompress(const char *&in, size_t &in_size, char *&out, size_t &out_size) {
+  if (ended) {
+    // anything after the end of a bz2 stream is ignored
+    in += in_size;
+    in_size = 0;
+    return true;
+  }
+
+  if (type == Type::BZ2) {
+    auto strm = (bz_stream *)bz2;
+    strm->next_in = (char *)in;
+    strm->avail_in = std::min<size_t>(in_size, UINT32_MAX);
+    strm->next_out = out;
+    strm->avail_out = std::min<size_t>(out_size, UINT32_MAX);
+    int bzerror = BZ2_bzDecompress(strm);
+    in_size -= strm->next_in - in;
+    in = strm->next_in;
+    out_size -= strm->next_out - out;
+    out = strm->next_out;
+    ended = bzerror == BZ_STREAM_END;
+    if (bzerror != BZ_OK && bzerror != BZ_STREAM_END) {
+      rWarning("decompressBZ2 error : content is corrupt");
+      return false;
+    }
+  } else if (type == Type::ZSTD) {
+    ZSTD_inBuffer input = {in, in_size, 0};
+    ZSTD_outBuffer output = {out, out_size, 0};
+    size_t err = ZSTD_decompressStream((ZSTD_DCtx *)zstd, &output, &input);
+    if (ZSTD_isError(err)) {
+      rWarning("decompressZST error : %s", ZSTD_getErrorName(err));
+      return false;
+    }
+    in += input.pos;
+    in_size -= input.pos;
+    out += output.pos;
+    out_size -= output.pos;
+  } else {
+    const size_t n = std::min(in_size, out_size);
+    memcpy(out, in, n);
+    in += n;
+    in_size -= n;
+    out += n;
+    out_size -= n;
+  }
+  return true;
+}
+
 void precise_nano_sleep(int64_t nanoseconds) {
 #ifdef __APPLE__
   const long estimate_ns = 1 * 1e6;  // 1ms
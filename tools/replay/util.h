@@ -40,6 +40,23 @@ std::string sha256(const std::string &str);
 void precise_nano_sleep(int64_t nanoseconds);
 std::string decompressBZ2(const std::string &in, std::atomic<bool> *abort = nullptr);
 std::string decompressBZ2(const std::byte *in, size_t in_size, std::atomic<bool> *abort = nullptr);
+std::string decompressZST(const std::string &in, std::atomic<bool> *abort = nullptr);
+
+// Decompresses a bz2 or zstd stream, or copies an uncompressed one, a piece at a time.
+class StreamDecompressor {
+public:
+  enum class Type { NONE, BZ2, ZSTD };
+  StreamDecompressor(Type type);
+  ~StreamDecompressor();
+  // decompresses from in into out and advances both, until the input is used up or out is full.
+  // false if the stream is corrupt
+  bool decompress(const char *&in, size_t &in_size, char *&out, size_t &out_size);
+
+private:
+  const Type type;
+  void *bz2 = nullptr, *zstd = nullptr;
+  bool ended = false;
+};
 std::string getUrlWithoutQuery(const std::string &url);
 size_t getRemoteFileSize(const std::string &url, std::atomic<bool> *abort = nullptr);
 std::string httpGet(const std::string &url, size_t chunk_size = 0, std::atomic<bool> *abort = nullptr);
@@ -47,4 +64,8 @@ std::string httpGet(const std::string &url, size_t chunk_size = 0, std::atomic<b
 typedef std::function<void(uint64_t cur, uint64_t total, bool success)> DownloadProgressHandler;
 void installDownloadProgressHandler(DownloadProgressHandler);
 bool httpDownload(const std::string &url, const std::string &file, size_t chunk_size = 0, std::atomic<bool> *abort = nullptr);
+// downloads from offset on over one connection and hands the data over as it arrives, stops if the
+// handler returns false
+typedef std::function<bool(const char *data, size_t size)> DownloadDataHandler;
+bool httpDownload(const std::string &url, const DownloadDataHandler &handler, std::atomic<bool> *abort = nullptr, size_t offset = 0);
 std::string formattedDataSize(size_t size);